@@ -0,0 +1,271 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wfrest/Arena.h"
+#include "wfrest/HeaderIndex.h"
+#include "wfrest/KvUtil.h"
+#include "wfrest/RouteParams.h"
+
+using namespace wfrest;
+
+// The request scoped data of HttpReq, on the heap as it was and in the
+// request Arena. One JSON object per line on stdout, like router_bench.
+//
+// ./arena_bench [requests=N] [headers=N] [fields=N]
+//
+// Per request : the lazily parsed data (ReqData), headers past
+// HeaderIndex::k_inline_size, route params past RouteParams::k_inline_size,
+// then the query, a urlencoded form and the cookies split with their
+// escapes decoded. fields is the number of params, query, form and cookie
+// fields each.
+// allocs counts operator new plus the chunks the arenas got from malloc.
+// split makes the arenas on one thread and destroys them on another, the
+// way a request is read on a network thread and finished on a handler
+// thread : the chunks have to find their way back for it to stay at 0.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// what ReqData holds that is not parsed yet
+struct Lazy
+{
+    std::string body;
+    std::map<std::string, std::string> form_kv;
+    KeyValues form_list;
+    KeyValues cookie_list;
+
+    explicit Lazy(Arena *arena)
+        : form_list(ArenaAllocator<KeyValue>(arena)),
+          cookie_list(ArenaAllocator<KeyValue>(arena))
+    {}
+};
+
+struct Input
+{
+    std::vector<std::string> header_names;
+    std::vector<std::string> param_names;
+    std::string path;
+    std::string query;
+    std::string form;
+    std::string cookie;
+};
+
+Input gen_input(size_t headers, size_t fields, std::mt19937 &rng)
+{
+    Input in;
+    for (size_t i = 0; i < headers; i++)
+        in.header_names.push_back("X-Header-" + std::to_string(i));
+    for (size_t i = 0; i < fields; i++)
+    {
+        std::string v = std::to_string(rng() % 100000);
+        in.param_names.push_back("p" + std::to_string(i));
+        in.path += "/" + v;
+        in.query += (i ? "&q" : "q") + std::to_string(i) + "=" + v + (i == 0 ? "%20x" : "");
+        in.form += (i ? "&f" : "f") + std::to_string(i) + "=" + v + (i == 0 ? "+y" : "");
+        in.cookie += (i ? "; c" : "c") + std::to_string(i) + "=" + v + (i == 0 ? "%3D" : "");
+    }
+    return in;
+}
+
+// arena nullptr : everything on the heap, like before the request arena
+size_t one_request(const Input &in, Arena *arena)
+{
+    Lazy *lazy;
+    if (arena)
+        lazy = new (arena->allocate(sizeof(Lazy), alignof(Lazy))) Lazy(arena);
+    else
+        lazy = new Lazy(nullptr);
+
+    HeaderIndex headers(arena);
+    for (const std::string &name : in.header_names)
+        headers.add(name, name);
+
+    RouteParams params(arena);
+    for (size_t i = 0; i < in.param_names.size(); i++)
+        params.add(in.param_names[i], StringPiece(in.path.data() + i, 1));
+
+    KeyValues query{ArenaAllocator<KeyValue>(arena)};
+    std::unique_ptr<char[]> query_buf, form_buf, cookie_buf;
+    if (arena)
+    {
+        KvUtil::split(in.query, KvSyntax::URLENCODED, query, arena);
+        KvUtil::split(in.form, KvSyntax::URLENCODED, lazy->form_list, arena);
+        KvUtil::split(in.cookie, KvSyntax::COOKIE, lazy->cookie_list, arena);
+    } else
+    {
+        KvUtil::split(in.query, KvSyntax::URLENCODED, query, query_buf);
+        KvUtil::split(in.form, KvSyntax::URLENCODED, lazy->form_list, form_buf);
+        KvUtil::split(in.cookie, KvSyntax::COOKIE, lazy->cookie_list, cookie_buf);
+    }
+
+    size_t n = headers.size() + params.size() + query.size() +
+               lazy->form_list.size() + lazy->cookie_list.size();
+    if (arena)
+        lazy->~Lazy();
+    else
+        delete lazy;
+    return n;
+}
+
+void report(const char *name, size_t requests, size_t headers, size_t fields,
+            size_t items, size_t allocs, uint64_t elapsed)
+{
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"requests\":%zu,\"headers\":%zu,\"fields\":%zu,"
+            "\"items\":%zu,\"allocs_per_request\":%.2f,\"ns_per_request\":%.1f}\n",
+            name, requests, headers, fields, items,
+            static_cast<double>(allocs) / requests,
+            static_cast<double>(elapsed) / requests);
+    fflush(stdout);
+}
+
+void bench(const char *name, const Input &in, size_t requests, bool use_arena)
+{
+    size_t items = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed) + Arena::mallocs();
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < requests; i++)
+    {
+        Arena *arena = use_arena ? Arena::create() : nullptr;
+        items += one_request(in, arena);
+        Arena::destroy(arena);
+    }
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) + Arena::mallocs() - allocs;
+    report(name, requests, in.header_names.size(), in.param_names.size(),
+           items, allocs, elapsed);
+}
+
+void bench_split(const char *name, const Input &in, size_t requests)
+{
+    const size_t batch_size = 64;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Arena *> queue;
+    bool done = false;
+
+    size_t items = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed) + Arena::mallocs();
+    uint64_t start = now_ns();
+    std::thread handler([&]()
+    {
+        std::vector<Arena *> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return !queue.empty() || done; });
+                if (queue.empty())
+                    break;
+                batch.swap(queue);
+            }
+            for (Arena *arena : batch)
+                Arena::destroy(arena);
+            batch.clear();
+        }
+    });
+
+    std::vector<Arena *> batch;
+    for (size_t i = 0; i < requests; i++)
+    {
+        Arena *arena = Arena::create();
+        items += one_request(in, arena);
+        batch.push_back(arena);
+        if (batch.size() == batch_size || i + 1 == requests)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.insert(queue.end(), batch.begin(), batch.end());
+            }
+            cond.notify_one();
+            batch.clear();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cond.notify_one();
+    handler.join();
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) + Arena::mallocs() - allocs;
+    report(name, requests, in.header_names.size(), in.param_names.size(),
+           items, allocs, elapsed);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    size_t requests = 1000000;
+    size_t headers = 24;
+    size_t fields = 12;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "requests=", 9) == 0)
+        {
+            requests = strtoul(argv[i] + 9, nullptr, 10);
+        } else if (strncmp(argv[i], "headers=", 8) == 0)
+        {
+            headers = strtoul(argv[i] + 8, nullptr, 10);
+        } else if (strncmp(argv[i], "fields=", 7) == 0)
+        {
+            fields = strtoul(argv[i] + 7, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (requests == 0)
+        requests = 1;
+
+    std::mt19937 rng(42);
+    Input in = gen_input(headers, fields, rng);
+    bench("heap", in, requests, false);
+    bench("arena", in, requests, true);
+    bench_split("arena_split", in, requests);
+    return 0;
+}
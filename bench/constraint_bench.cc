@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "wfrest/HttpServer.h"
+#include "wfrest/RouteConstraint.h"
+
+using namespace wfrest;
+
+// Cost of the {name:spec} route constraints.
+// One JSON object per line on stdout, like router_bench.
+//
+// ./constraint_bench [lookups=N]
+//
+// constraint_match : ns per segment of RouteConstraint::match
+// router_call      : /user/{id:int} + /user/{u:uuid} + /user/{name}
+//                    against the same routes with plain {param} only
+
+namespace
+{
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string gen_int(std::mt19937 &rng)
+{
+    return std::to_string(rng() % 10000000);
+}
+
+std::string gen_uuid(std::mt19937 &rng)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string s;
+    for (int i = 0; i < 36; i++)
+        s += (i == 8 || i == 13 || i == 18 || i == 23) ? '-' : hex[rng() % 16];
+    return s;
+}
+
+std::string gen_slug(std::mt19937 &rng)
+{
+    std::string s;
+    size_t len = 8 + rng() % 24;
+    for (size_t i = 0; i < len; i++)
+        s += (i % 6 == 5) ? '-' : static_cast<char>('a' + rng() % 26);
+    return s;
+}
+
+void bench_match(const char *spec, std::string (*gen)(std::mt19937 &),
+                 size_t lookups, std::mt19937 &rng)
+{
+    RouteConstraint constraint;
+    if (!constraint.compile(spec))
+    {
+        fprintf(stderr, "cannot compile %s\n", spec);
+        return;
+    }
+    const size_t n = 1 << 12;
+    std::vector<std::string> segs(n);
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        segs[i] = gen(rng);
+        bytes += segs[i].size();
+    }
+
+    size_t matched = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+        matched += constraint.match(segs[i & (n - 1)]);
+    uint64_t elapsed = now_ns() - start;
+
+    fprintf(stdout,
+            "{\"bench\":\"constraint_match\",\"spec\":\"%s\",\"states\":%zu,"
+            "\"lookups\":%zu,\"matched\":%zu,\"avg_len\":%.1f,\"ns_per_op\":%.2f}\n",
+            spec, constraint.state_count(), lookups, matched,
+            static_cast<double>(bytes) / n, static_cast<double>(elapsed) / lookups);
+    fflush(stdout);
+}
+
+// new_session() is the only way to get a task without a connection
+class BenchServer : public HttpServer
+{
+public:
+    HttpServerTask *new_task()
+    { return static_cast<HttpServerTask *>(this->new_session(0, nullptr)); }
+};
+
+void bench_router(bool constrained, size_t lookups, HttpServerTask *task, std::mt19937 &rng)
+{
+    Router router;
+    WrapHandler handler = [](HttpReq *, HttpResp *, SeriesWork *) -> WFGoTask *
+    {
+        return nullptr;
+    };
+    if (constrained)
+    {
+        router.handle("/user/{id:int}", -1, handler, Verb::GET);
+        router.handle("/user/{id:int}/posts", -1, handler, Verb::GET);
+        router.handle("/user/{u:uuid}", -1, handler, Verb::GET);
+    }
+    router.handle("/user/{name}", -1, handler, Verb::GET);
+    router.handle("/user/{name}/posts", -1, handler, Verb::GET);
+    router.publish();
+
+    const size_t n = 1 << 12;
+    std::vector<std::string> reqs(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        switch (rng() % 4)
+        {
+        case 0:
+            reqs[i] = "/user/" + gen_int(rng);
+            break;
+        case 1:
+            reqs[i] = "/user/" + gen_int(rng) + "/posts";
+            break;
+        case 2:
+            reqs[i] = "/user/" + gen_uuid(rng);
+            break;
+        default:
+            reqs[i] = "/user/" + gen_slug(rng);
+            break;
+        }
+    }
+
+    size_t found = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+        found += router.call(Verb::GET, reqs[i & (n - 1)], task) == StatusOK;
+    uint64_t elapsed = now_ns() - start;
+
+    fprintf(stdout,
+            "{\"bench\":\"router_call\",\"constrained\":%d,\"lookups\":%zu,\"found\":%zu,"
+            "\"ops_per_sec\":%.0f,\"ns_per_op\":%.1f}\n",
+            constrained ? 1 : 0, lookups, found,
+            lookups * 1e9 / elapsed, static_cast<double>(elapsed) / lookups);
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    size_t lookups = 1000000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "lookups=", 8) == 0)
+        {
+            lookups = strtoul(argv[i] + 8, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (lookups == 0)
+        lookups = 1;
+
+    std::mt19937 rng(42);
+    bench_match("int", gen_int, lookups, rng);
+    bench_match("uuid", gen_uuid, lookups, rng);
+    bench_match("[a-z]+(-[a-z]+)*", gen_slug, lookups, rng);
+
+    BenchServer svr;
+    HttpServerTask *task = svr.new_task();
+    bench_router(false, lookups, task, rng);
+    bench_router(true, lookups, task, rng);
+    // the task never ran, so it is not freed by a series
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wfrest/HttpDate.h"
+#include "wfrest/Timestamp.h"
+
+using namespace wfrest;
+
+// Date header, access log time and cookie Expires formatting, before and
+// after HttpDate, from many threads at once.
+// One JSON object per line on stdout, like router_bench.
+//
+// ./date_bench [threads=N] [ops=N]
+//
+// legacy_date   : Timestamp::now().to_format_str() as message_out() did
+// date          : HttpDate::now(), the per second cache
+// legacy_log    : Timestamp::now().to_format_str() as track() did
+// log           : HttpDate::now_log()
+// legacy_format : Timestamp(t).to_format_str() as HttpCookie::dump() did
+// format        : HttpDate::format(t)
+// ops is per thread, ns_per_op is the wall time over all the ops.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *k_gmt_fmt = "%a, %d %b %Y %H:%M:%S GMT";
+
+template<typename F>
+void bench(const char *name, size_t threads, size_t ops, F op)
+{
+    std::atomic<size_t> sink{0};
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            ready++;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            size_t sum = 0;
+            for (size_t i = 0; i < ops; i++)
+                sum += op(t * ops + i);
+            sink += sum;
+        });
+    }
+    while (ready.load() < threads)
+        std::this_thread::yield();
+
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t start = now_ns();
+    go.store(true, std::memory_order_release);
+    for (std::thread &worker : workers)
+        worker.join();
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
+
+    size_t total = threads * ops;
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"threads\":%zu,\"ops\":%zu,\"sink\":%zu,"
+            "\"allocs_per_op\":%.2f,\"ns_per_op\":%.1f,\"mops_per_sec\":%.2f}\n",
+            name, threads, ops, sink.load(), static_cast<double>(allocs) / total,
+            static_cast<double>(elapsed) / total,
+            static_cast<double>(total) * 1000.0 / elapsed);
+    fflush(stdout);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    size_t threads = 64;
+    size_t ops = 100000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "threads=", 8) == 0)
+        {
+            threads = strtoul(argv[i] + 8, nullptr, 10);
+        } else if (strncmp(argv[i], "ops=", 4) == 0)
+        {
+            ops = strtoul(argv[i] + 4, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (threads == 0)
+        threads = 1;
+    if (ops == 0)
+        ops = 1;
+
+    bench("legacy_date", threads, ops, [](size_t)
+    {
+        return Timestamp::now().to_format_str(k_gmt_fmt).size();
+    });
+    bench("date", threads, ops, [](size_t)
+    {
+        char date[HttpDate::k_date_len];
+        HttpDate::now(date);
+        return static_cast<size_t>(date[5]);
+    });
+
+    bench("legacy_log", threads, ops, [](size_t)
+    {
+        return Timestamp::now().to_format_str().size();
+    });
+    bench("log", threads, ops, [](size_t)
+    {
+        char log[HttpDate::k_log_len];
+        HttpDate::now_log(log);
+        return static_cast<size_t>(log[18]);
+    });
+
+    // a different second each time, nothing to cache
+    bench("legacy_format", threads, ops, [](size_t i)
+    {
+        Timestamp t(static_cast<uint64_t>(1600000000 + i) * Timestamp::k_micro_sec_per_sec);
+        return t.to_format_str(k_gmt_fmt).size();
+    });
+    bench("format", threads, ops, [](size_t i)
+    {
+        char date[HttpDate::k_date_len];
+        HttpDate::format(static_cast<time_t>(1600000000 + i), date);
+        return static_cast<size_t>(date[24]);
+    });
+    return 0;
+}
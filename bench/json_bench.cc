@@ -0,0 +1,139 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include "wfrest/json.hpp"
+#include "wfrest/JsonUtil.h"
+
+using namespace wfrest;
+using Json = nlohmann::json;
+
+// Request json parsing in HttpReq::json(), before and after JsonUtil.
+// One JSON object per line on stdout, like router_bench.
+//
+// ./json_bench [bytes=N]
+//
+// accept_parse  : Json::accept() then Json::parse(), the old json()
+// parse_default : JsonUtil::parse_default, one nlohmann pass
+// parse         : JsonUtil::parse, simdjson from k_fast_parse_min on if
+//                 wfrest was built with WFREST_WITH_SIMDJSON
+// Each document is parsed until about bytes=N (256MB) went through.
+
+namespace
+{
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// an array of users, like an ordinary api payload
+std::string gen_doc(size_t items, std::mt19937 &rng)
+{
+    Json doc;
+    doc["request_id"] = std::to_string(rng());
+    Json &users = doc["users"];
+    users = Json::array();
+    for (size_t i = 0; i < items; i++)
+    {
+        Json user;
+        user["id"] = rng() % 1000000;
+        user["name"] = "user_" + std::to_string(rng() % 100000);
+        user["score"] = (rng() % 10000) / 100.0;
+        user["active"] = rng() % 2 == 0;
+        user["tags"] = {"a", "bé", std::to_string(rng() % 100)};
+        user["manager"] = nullptr;
+        users.push_back(user);
+    }
+    return doc.dump();
+}
+
+void report(const char *name, const char *doc, size_t doc_bytes, size_t docs, uint64_t elapsed)
+{
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"doc\":\"%s\",\"doc_bytes\":%zu,\"docs\":%zu,"
+            "\"ns_per_op\":%.1f,\"mb_per_s\":%.1f}\n",
+            name, doc, doc_bytes, docs, static_cast<double>(elapsed) / docs,
+            static_cast<double>(doc_bytes) * docs * 1000 / elapsed);
+    fflush(stdout);
+}
+
+void bench_accept_parse(const char *name, const std::string &doc, size_t docs)
+{
+    const char *begin = doc.data();
+    const char *end = begin + doc.size();
+    size_t sink = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < docs; i++)
+    {
+        if (!Json::accept(begin, end))
+            continue;
+        Json json = Json::parse(begin, end);
+        sink += json.size();
+    }
+    uint64_t elapsed = now_ns() - start;
+    if (sink == 0)
+        fprintf(stderr, "nothing parsed\n");
+    report("accept_parse", name, doc.size(), docs, elapsed);
+}
+
+template<bool (*Parse)(const char *, size_t, Json &, JsonError &)>
+void bench_json_util(const char *bench, const char *name, const std::string &doc, size_t docs)
+{
+    size_t sink = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < docs; i++)
+    {
+        Json json;
+        JsonError err;
+        if (Parse(doc.data(), doc.size(), json, err))
+            sink += json.size();
+    }
+    uint64_t elapsed = now_ns() - start;
+    if (sink == 0)
+        fprintf(stderr, "nothing parsed\n");
+    report(bench, name, doc.size(), docs, elapsed);
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    size_t bytes = 256 << 20;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "bytes=", 6) == 0)
+        {
+            bytes = strtoul(argv[i] + 6, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(42);
+    struct
+    {
+        const char *name;
+        std::string doc;
+    } docs[] = {
+        { "small", gen_doc(1, rng) },
+        { "medium", gen_doc(128, rng) },
+        { "large", gen_doc(32 * 1024, rng) },
+    };
+
+    for (auto &d : docs)
+    {
+        size_t n = bytes / d.doc.size();
+        if (n == 0)
+            n = 1;
+        bench_accept_parse(d.name, d.doc, n);
+        bench_json_util<JsonUtil::parse_default>("parse_default", d.name, d.doc, n);
+        bench_json_util<JsonUtil::parse>("parse", d.name, d.doc, n);
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "wfrest/KvUtil.h"
+#include "wfrest/StrUtil.h"
+
+using namespace wfrest;
+
+// Urlencoded form and Cookie header splitting, before and after KvUtil.
+// One JSON object per line on stdout, like router_bench.
+//
+// ./kv_bench [lookups=N] [fields=N]
+//
+// legacy_form   : Urlencode::parse_post_kv as it was, split_piece into a map
+// legacy_cookie : HttpCookie::split as it was, the same on ','
+// split_*       : KvUtil::split into a flat vector of views
+// split_map_*   : KvUtil::split_to_map, what form_kv() and cookies() build
+// Every 4th input has escapes, which only split_* decode.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::map<std::string, std::string> legacy_form(const StringPiece &body)
+{
+    std::map<std::string, std::string> map;
+    std::vector<StringPiece> arr = StrUtil::split_piece<StringPiece>(body, '&');
+    for (const auto &ele: arr)
+    {
+        if (ele.empty())
+            continue;
+        std::vector<std::string> kv = StrUtil::split_piece<std::string>(ele, '=');
+        std::string &key = kv[0];
+        if (key.empty() || map.count(key) > 0)
+            continue;
+        if (kv.size() == 1)
+            map.emplace(std::move(key), "");
+        else
+            map.emplace(std::move(key), std::move(kv[1]));
+    }
+    return map;
+}
+
+std::map<std::string, std::string> legacy_cookie(const StringPiece &cookie)
+{
+    std::map<std::string, std::string> res;
+    std::vector<StringPiece> arr = StrUtil::split_piece<StringPiece>(cookie, ',');
+    std::map<StringPiece, StringPiece> piece_res;
+    for (const auto &ele: arr)
+    {
+        if (ele.empty())
+            continue;
+        std::vector<StringPiece> kv = StrUtil::split_piece<StringPiece>(ele, '=');
+        StringPiece &key = kv[0];
+        if (key.empty() || piece_res.count(key) > 0)
+            continue;
+        if (kv.size() == 1)
+            piece_res.emplace(StrUtil::trim(key), "");
+        else
+            piece_res.emplace(StrUtil::trim(key), StrUtil::trim(kv[1]));
+    }
+    for (auto &piece: piece_res)
+        res.emplace(piece.first.as_string(), piece.second.as_string());
+    return res;
+}
+
+std::string gen_value(std::mt19937 &rng, bool escaped)
+{
+    std::string v = "v" + std::to_string(rng() % 1000000);
+    if (escaped)
+        v += "%20x+y%2F";
+    return v;
+}
+
+std::vector<std::string> gen_inputs(size_t n, size_t fields, bool cookie, std::mt19937 &rng)
+{
+    std::vector<std::string> inputs(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        std::string &s = inputs[i];
+        for (size_t f = 0; f < fields; f++)
+        {
+            if (f)
+                s += cookie ? "; " : "&";
+            s += (cookie ? "session_" : "field_") + std::to_string(f);
+            s += '=';
+            s += gen_value(rng, i % 4 == 0 && f == fields / 2);
+        }
+    }
+    return inputs;
+}
+
+void report(const char *name, size_t fields, size_t lookups, size_t pairs,
+            size_t allocs, uint64_t elapsed)
+{
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"fields\":%zu,\"lookups\":%zu,\"pairs\":%zu,"
+            "\"allocs_per_op\":%.2f,\"ns_per_op\":%.1f}\n",
+            name, fields, lookups, pairs, static_cast<double>(allocs) / lookups,
+            static_cast<double>(elapsed) / lookups);
+    fflush(stdout);
+}
+
+template<typename F>
+void bench_map(const char *name, const std::vector<std::string> &inputs,
+               size_t fields, size_t lookups, F split)
+{
+    size_t n = inputs.size();
+    size_t pairs = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+        pairs += split(StringPiece(inputs[i & (n - 1)])).size();
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
+    report(name, fields, lookups, pairs, allocs, elapsed);
+}
+
+// pairs is reused across inputs, like it lives as long as the request
+void bench_split(const char *name, const std::vector<std::string> &inputs,
+                 size_t fields, size_t lookups, KvSyntax syntax)
+{
+    size_t n = inputs.size();
+    size_t pairs = 0;
+    KeyValues kvs;
+    std::unique_ptr<char[]> buf;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        KvUtil::split(StringPiece(inputs[i & (n - 1)]), syntax, kvs, buf);
+        pairs += kvs.size();
+    }
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
+    report(name, fields, lookups, pairs, allocs, elapsed);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    size_t lookups = 1000000;
+    size_t fields = 8;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "lookups=", 8) == 0)
+        {
+            lookups = strtoul(argv[i] + 8, nullptr, 10);
+        } else if (strncmp(argv[i], "fields=", 7) == 0)
+        {
+            fields = strtoul(argv[i] + 7, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (lookups == 0)
+        lookups = 1;
+    if (fields == 0)
+        fields = 1;
+
+    std::mt19937 rng(42);
+    std::vector<std::string> forms = gen_inputs(1 << 10, fields, false, rng);
+    std::vector<std::string> cookies = gen_inputs(1 << 10, fields, true, rng);
+
+    bench_map("legacy_form", forms, fields, lookups, legacy_form);
+    bench_map("split_map_form", forms, fields, lookups, [](const StringPiece &s)
+    {
+        return KvUtil::split_to_map(s, KvSyntax::URLENCODED);
+    });
+    bench_split("split_form", forms, fields, lookups, KvSyntax::URLENCODED);
+
+    bench_map("legacy_cookie", cookies, fields, lookups, legacy_cookie);
+    bench_map("split_map_cookie", cookies, fields, lookups, [](const StringPiece &s)
+    {
+        return KvUtil::split_to_map(s, KvSyntax::COOKIE);
+    });
+    bench_split("split_cookie", cookies, fields, lookups, KvSyntax::COOKIE);
+    return 0;
+}
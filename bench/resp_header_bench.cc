@@ -0,0 +1,197 @@
+#include "workflow/HttpMessage.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include "wfrest/Arena.h"
+#include "wfrest/HttpCookie.h"
+#include "wfrest/HttpDate.h"
+#include "wfrest/HttpMsg.h"
+#include "wfrest/RespHeaders.h"
+#include "wfrest/StrUtil.h"
+
+using namespace wfrest;
+using namespace protocol;
+
+// The headers of a small json response, the way message_out() built them
+// and the way it does now. One JSON object per line on stdout, like
+// router_bench.
+//
+// ./resp_header_bench [ops=N] [headers=N]
+//
+// legacy : resp->headers, a case insensitive map, every entry, the
+//          defaults, a cookie and the Content-Length added to the protocol
+//          message one add_header() at a time
+// flat   : RespHeaders in the arena of the response, literals not copied,
+//          all of it written into one string reused by the thread, then
+//          copied into the arena
+// Before both, the one line of {"check":"head_splice"} tells whether
+// HttpResp::encode() works with the linked workflow, exit status 1 if not.
+// headers is the number of headers the handler sets besides Content-Type.
+// Both create the protocol message of a response per op, flat its arena too.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename F>
+void bench(const char *name, size_t ops, F op)
+{
+    size_t sink = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    size_t arena_mallocs = Arena::mallocs();
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        sink += op(i);
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs + Arena::mallocs() - arena_mallocs;
+
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"ops\":%zu,\"sink\":%zu,"
+            "\"allocs_per_op\":%.2f,\"ns_per_op\":%.1f,\"mops_per_sec\":%.2f}\n",
+            name, ops, sink, static_cast<double>(allocs) / ops,
+            static_cast<double>(elapsed) / ops,
+            static_cast<double>(ops) * 1000.0 / elapsed);
+    fflush(stdout);
+}
+
+void add_header(HttpResponse &resp, const char *name, size_t name_len,
+                const char *value, size_t value_len)
+{
+    struct HttpMessageHeader header;
+    header.name = name;
+    header.name_len = name_len;
+    header.value = value;
+    header.value_len = value_len;
+    resp.add_header(&header);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    size_t ops = 1000000;
+    size_t num_headers = 2;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "ops=", 4) == 0)
+        {
+            ops = strtoul(argv[i] + 4, nullptr, 10);
+        } else if (strncmp(argv[i], "headers=", 8) == 0)
+        {
+            num_headers = strtoul(argv[i] + 8, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (ops == 0)
+        ops = 1;
+
+    bool splice = HttpResp::head_splice_works();
+    fprintf(stdout, "{\"check\":\"head_splice\",\"ok\":%s}\n", splice ? "true" : "false");
+    fflush(stdout);
+    if (!splice)
+        return 1;
+
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+    for (size_t i = 0; i < num_headers; i++)
+    {
+        names.push_back("X-Bench-Header-" + std::to_string(i));
+        values.push_back("value-" + std::to_string(i * 7919));
+    }
+    HttpCookie cookie;
+    cookie.set_key("session").set_value("0123456789abcdef").set_path("/").set_http_only(true);
+    const size_t body_size = 27;    // {"errmsg":"OK","code":0}\n or so
+
+    bench("legacy", ops, [&](size_t)
+    {
+        HttpResponse resp;
+        std::map<std::string, std::string, MapStringCaseLess> headers;
+        headers["Content-Type"] = "application/json";
+        for (size_t i = 0; i < num_headers; i++)
+            headers[names[i]] = values[i];
+
+        for (auto &header_kv : headers)
+            add_header(resp, header_kv.first.c_str(), header_kv.first.size(),
+                       header_kv.second.c_str(), header_kv.second.size());
+        char date[HttpDate::k_date_len];
+        HttpDate::now(date);
+        add_header(resp, "Date", 4, date, HttpDate::k_date_len);
+        std::string cookie_str = cookie.dump();
+        add_header(resp, "Set-Cookie", 10, cookie_str.c_str(), cookie_str.size());
+        char buf[32];
+        int len = sprintf(buf, "%zu", body_size);
+        add_header(resp, "Content-Length", 14, buf, len);
+        add_header(resp, "Connection", 10, "Keep-Alive", 10);
+        return cookie_str.size() + len;
+    });
+
+    std::string head;     // the one of the thread
+    bench("flat", ops, [&](size_t)
+    {
+        HttpResponse resp;
+        Arena *arena = Arena::create();
+        RespHeaders fields(arena);
+        fields.set_static(HEADER_CONTENT_TYPE, "application/json");
+        for (size_t i = 0; i < num_headers; i++)
+            fields.set(names[i], values[i]);
+
+        head.clear();
+        fields.serialize(head);
+        char date[HttpDate::k_date_len];
+        HttpDate::now(date);
+        head.append("Date: ").append(date, HttpDate::k_date_len).append("\r\n");
+        head.append("Set-Cookie: ");
+        cookie.dump(head);
+        head.append("\r\n");
+        char buf[32];
+        int len = sprintf(buf, "%zu", body_size);
+        head.append("Content-Length: ").append(buf, len).append("\r\n");
+        head.append("Connection: Keep-Alive\r\n");
+        char *p = static_cast<char *>(arena->allocate(head.size(), 1));
+        memcpy(p, head.data(), head.size());
+        Arena::destroy(arena);
+        return head.size();
+    });
+    return 0;
+}
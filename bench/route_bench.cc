@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "wfrest/RouteTable.h"
+
+using namespace wfrest;
+
+// Lookup cost of RouteTable before and after freeze()
+// ./route_bench [lookups]
+
+static std::vector<std::string> gen_routes(size_t n, std::mt19937 &rng)
+{
+    std::vector<std::string> routes;
+    routes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        // /api/v{x}/res{y}/... one param or prefix* every few routes
+        std::string route = "/api/v" + std::to_string(rng() % 4);
+        route += "/res" + std::to_string(i / 8);
+        switch (i % 8)
+        {
+        case 0:
+            route += "/{id}";
+            break;
+        case 1:
+            route += "/{id}/detail";
+            break;
+        case 2:
+            route += "/static*";
+            break;
+        default:
+            route += "/action" + std::to_string(i % 8);
+            break;
+        }
+        routes.push_back(std::move(route));
+    }
+    return routes;
+}
+
+// turn a route definition into a request path
+static std::string to_request(const std::string &route, std::mt19937 &rng)
+{
+    std::string req;
+    for (size_t i = 0; i < route.size(); i++)
+    {
+        if (route[i] == '{')
+        {
+            req += std::to_string(rng() % 100000);
+            while (route[i] != '}') i++;
+        } else if (route[i] == '*')
+        {
+            req += "/css/main.css";
+        } else
+        {
+            req += route[i];
+        }
+    }
+    return req;
+}
+
+// exact: try the parameter-free table first, as Router::call does
+static double run(const RouteTable &table, const std::vector<std::string> &reqs,
+                  size_t lookups, bool exact)
+{
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        const std::string &req = reqs[i % reqs.size()];
+        if (exact && table.find_exact(req))
+        {
+            found++;
+            continue;
+        }
+        RouteParams route_params;
+        StringPiece route_match_path;
+        if (table.find(req, route_params, route_match_path))
+            found++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (found != lookups)
+        fprintf(stderr, "only %zu / %zu lookups matched\n", found, lookups);
+    return std::chrono::duration<double, std::nano>(end - start).count() / lookups;
+}
+
+int main(int argc, char **argv)
+{
+    size_t lookups = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    std::mt19937 rng(42);
+
+    fprintf(stdout, "%-8s %-14s %-14s %-14s\n", "routes", "tree ns/op", "trie ns/op", "exact ns/op");
+    for (size_t n : {100, 1000, 10000})
+    {
+        std::vector<std::string> routes = gen_routes(n, rng);
+        RouteTable table;
+        for (auto &route : routes)
+        {
+            VerbHandler &vh = table.find_or_create(route.c_str());
+            vh.insert(Verb::GET, nullptr);
+            vh.path = route;
+        }
+
+        std::vector<std::string> reqs;
+        reqs.reserve(4096);
+        for (size_t i = 0; i < 4096; i++)
+            reqs.push_back(to_request(routes[rng() % routes.size()], rng));
+
+        double tree_ns = run(table, reqs, lookups, false);
+        table.freeze();
+        double trie_ns = run(table, reqs, lookups, false);
+        double exact_ns = run(table, reqs, lookups, true);
+        fprintf(stdout, "%-8zu %-14.1f %-14.1f %-14.1f\n", n, tree_ns, trie_ns, exact_ns);
+    }
+    return 0;
+}
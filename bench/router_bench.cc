@@ -0,0 +1,307 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "wfrest/HttpServer.h"
+
+using namespace wfrest;
+
+// Router::call on synthetic route sets, without the network.
+// One JSON object per line on stdout, so runs can be diffed and plotted.
+//
+// ./router_bench [routes=N] [lookups=N] [literal=%] [param=%] [prefix=%]
+//                [miss=%] [zipf=s] [ids=N] [cache=0|1]
+//
+// routes  : a single route count, default runs 100, 1000 and 10000
+// literal, param, prefix : mix of the generated routes, in percent
+// miss    : percent of lookups that match no route
+// zipf    : skew of the trace, 0 is uniform
+// ids     : distinct values a {param} takes in the trace
+// cache   : Router::set_match_cache
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+struct Options
+{
+    size_t routes = 0;
+    size_t lookups = 1000000;
+    unsigned literal = 60;
+    unsigned param = 30;
+    unsigned prefix = 10;
+    unsigned miss = 5;
+    double zipf = 1.0;
+    size_t ids = 100;
+    bool cache = false;
+};
+
+bool parse_option(const char *arg, Options &opt)
+{
+    const char *eq = strchr(arg, '=');
+    if (!eq)
+        return false;
+    std::string key(arg, eq - arg);
+    const char *val = eq + 1;
+    if (key == "routes")
+        opt.routes = strtoul(val, nullptr, 10);
+    else if (key == "lookups")
+        opt.lookups = strtoul(val, nullptr, 10);
+    else if (key == "literal")
+        opt.literal = atoi(val);
+    else if (key == "param")
+        opt.param = atoi(val);
+    else if (key == "prefix")
+        opt.prefix = atoi(val);
+    else if (key == "miss")
+        opt.miss = atoi(val);
+    else if (key == "zipf")
+        opt.zipf = atof(val);
+    else if (key == "ids")
+        opt.ids = strtoul(val, nullptr, 10);
+    else if (key == "cache")
+        opt.cache = atoi(val) != 0;
+    else
+        return false;
+    return true;
+}
+
+enum RouteKind { LITERAL, PARAM, PREFIX };
+
+struct RouteDef
+{
+    std::string route;
+    RouteKind kind;
+};
+
+std::vector<RouteDef> gen_routes(size_t n, const Options &opt, std::mt19937 &rng)
+{
+    unsigned total = opt.literal + opt.param + opt.prefix;
+    std::vector<RouteDef> routes;
+    routes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned pick = total ? rng() % total : 0;
+        // /api/v{x}/res{i/4}/... so that routes share prefixes like real APIs
+        std::string route = "/api/v" + std::to_string(i % 3);
+        route += "/res" + std::to_string(i / 4);
+        if (pick < opt.literal)
+        {
+            route += "/action" + std::to_string(i % 4);
+            routes.push_back({route, LITERAL});
+        } else if (pick < opt.literal + opt.param)
+        {
+            route += i % 2 ? "/{id}" : "/{id}/detail" + std::to_string(i % 4);
+            routes.push_back({route, PARAM});
+        } else
+        {
+            route += "/files" + std::to_string(i % 4) + "*";
+            routes.push_back({route, PREFIX});
+        }
+    }
+    return routes;
+}
+
+std::string to_request(const RouteDef &def, size_t ids, std::mt19937 &rng)
+{
+    const std::string &route = def.route;
+    std::string req;
+    for (size_t i = 0; i < route.size(); i++)
+    {
+        if (route[i] == '{')
+        {
+            req += std::to_string(10000 + rng() % ids);
+            while (route[i] != '}') i++;
+        } else if (route[i] == '*')
+        {
+            req += "/css/main" + std::to_string(rng() % 100) + ".css";
+        } else
+        {
+            req += route[i];
+        }
+    }
+    return req;
+}
+
+// route index of each lookup, hot routes first as in production traffic
+std::vector<size_t> gen_trace(size_t n, size_t len, double s, std::mt19937 &rng)
+{
+    std::vector<double> cdf(n);
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+        cdf[i] = sum;
+    }
+    // the hot set should not be the first routes registered
+    std::vector<size_t> rank(n);
+    for (size_t i = 0; i < n; i++)
+        rank[i] = i;
+    std::shuffle(rank.begin(), rank.end(), rng);
+
+    std::uniform_real_distribution<double> dist(0, sum);
+    std::vector<size_t> trace(len);
+    for (size_t i = 0; i < len; i++)
+    {
+        size_t r = std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin();
+        trace[i] = rank[std::min(r, n - 1)];
+    }
+    return trace;
+}
+
+// new_session() is the only way to get a task without a connection
+class BenchServer : public HttpServer
+{
+public:
+    HttpServerTask *new_task()
+    { return static_cast<HttpServerTask *>(this->new_session(0, nullptr)); }
+};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void run(size_t n, const Options &opt, HttpServerTask *task, std::mt19937 &rng)
+{
+    std::vector<RouteDef> defs = gen_routes(n, opt, rng);
+    Router router;
+    WrapHandler handler = [](HttpReq *, HttpResp *, SeriesWork *) -> WFGoTask *
+    {
+        return nullptr;
+    };
+    for (auto &def : defs)
+        router.handle(def.route.c_str(), -1, handler, Verb::GET);
+    router.publish();
+    router.set_match_cache(opt.cache);
+
+    // the requests are built up front, a lookup only reads them
+    const size_t trace_len = 1 << 16;
+    std::vector<size_t> trace = gen_trace(n, trace_len, opt.zipf, rng);
+    std::vector<std::string> reqs(trace_len);
+    for (size_t i = 0; i < trace_len; i++)
+    {
+        if (rng() % 100 < opt.miss)
+            reqs[i] = "/nope/" + std::to_string(rng() % 100000);
+        else
+            reqs[i] = to_request(defs[trace[i]], opt.ids, rng);
+    }
+
+    // warm up the caches and the match cache
+    size_t found = 0;
+    for (size_t i = 0; i < trace_len; i++)
+        found += router.call(Verb::GET, reqs[i], task) == StatusOK;
+
+    // throughput
+    RouterStats before = router.stats();
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    found = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < opt.lookups; i++)
+        found += router.call(Verb::GET, reqs[i & (trace_len - 1)], task) == StatusOK;
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
+    RouterStats stats = router.stats();
+
+    // latency, each lookup timed on its own, minus the cost of the clock
+    uint64_t clock_ns = UINT64_MAX;
+    for (int i = 0; i < 1000; i++)
+    {
+        uint64_t t0 = now_ns();
+        uint64_t t1 = now_ns();
+        clock_ns = std::min(clock_ns, t1 - t0);
+    }
+    size_t samples = std::min<size_t>(opt.lookups, 200000);
+    std::vector<uint64_t> lat(samples);
+    for (size_t i = 0; i < samples; i++)
+    {
+        const std::string &req = reqs[i & (trace_len - 1)];
+        uint64_t t0 = now_ns();
+        router.call(Verb::GET, req, task);
+        uint64_t t1 = now_ns();
+        lat[i] = t1 - t0 > clock_ns ? t1 - t0 - clock_ns : 0;
+    }
+    std::sort(lat.begin(), lat.end());
+
+    fprintf(stdout,
+            "{\"bench\":\"router_call\",\"routes\":%zu,"
+            "\"literal\":%u,\"param\":%u,\"prefix\":%u,\"miss\":%u,\"zipf\":%.2f,\"ids\":%zu,\"cache\":%d,"
+            "\"lookups\":%zu,\"found\":%zu,\"ops_per_sec\":%.0f,\"ns_per_op\":%.1f,"
+            "\"p50_ns\":%llu,\"p99_ns\":%llu,\"allocs_per_lookup\":%.3f,"
+            "\"exact_hit\":%llu,\"exact_miss\":%llu,\"cache_hit\":%llu,\"cache_miss\":%llu}\n",
+            n, opt.literal, opt.param, opt.prefix, opt.miss, opt.zipf, opt.ids, opt.cache ? 1 : 0,
+            opt.lookups, found, opt.lookups * 1e9 / elapsed, static_cast<double>(elapsed) / opt.lookups,
+            (unsigned long long)lat[samples / 2], (unsigned long long)lat[samples * 99 / 100],
+            static_cast<double>(allocs) / opt.lookups,
+            (unsigned long long)(stats.exact_hit - before.exact_hit),
+            (unsigned long long)(stats.exact_miss - before.exact_miss),
+            (unsigned long long)(stats.cache_hit - before.cache_hit),
+            (unsigned long long)(stats.cache_miss - before.cache_miss));
+    fflush(stdout);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!parse_option(argv[i], opt))
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opt.lookups == 0)
+        opt.lookups = 1;
+    if (opt.ids == 0)
+        opt.ids = 1;
+
+    std::mt19937 rng(42);
+    BenchServer svr;
+    HttpServerTask *task = svr.new_task();
+
+    std::vector<size_t> sizes;
+    if (opt.routes)
+        sizes.push_back(opt.routes);
+    else
+        sizes = {100, 1000, 10000};
+
+    for (size_t n : sizes)
+        run(n, opt, task, rng);
+    // the task never ran, so it is not freed by a series
+    return 0;
+}
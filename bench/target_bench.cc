@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "wfrest/UriUtil.h"
+
+using namespace wfrest;
+
+// Request target parsing in HttpServer::process, before and after
+// UriUtil::parse_target. One JSON object per line on stdout, like router_bench.
+//
+// ./target_bench [lookups=N]
+//
+// uri_parser   : "http://" + host + uri through URIParser::parse
+// parse_target : path and query split in place
+// allocs counts operator new plus the fields URIParser::parse strdup()s.
+
+namespace
+{
+
+std::atomic<size_t> g_allocs{0};
+
+inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<std::string> gen_targets(size_t n, std::mt19937 &rng)
+{
+    std::vector<std::string> targets(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        std::string &t = targets[i];
+        t = "/api/v" + std::to_string(rng() % 4) + "/user/" + std::to_string(rng() % 100000);
+        switch (rng() % 4)
+        {
+        case 0:
+            t += "/posts?page=" + std::to_string(rng() % 100) + "&sort=desc";
+            break;
+        case 1:
+            t += "/avatar.png";
+            break;
+        case 2:
+            t += "/./posts//latest";  // has to be normalised
+            break;
+        default:
+            break;
+        }
+    }
+    return targets;
+}
+
+size_t parsed_uri_fields(const ParsedURI &uri)
+{
+    return (uri.scheme != nullptr) + (uri.userinfo != nullptr) + (uri.host != nullptr) +
+           (uri.port != nullptr) + (uri.path != nullptr) + (uri.query != nullptr) +
+           (uri.fragment != nullptr);
+}
+
+void report(const char *name, size_t lookups, size_t bytes, size_t allocs, uint64_t elapsed)
+{
+    fprintf(stdout,
+            "{\"bench\":\"%s\",\"lookups\":%zu,\"bytes\":%zu,"
+            "\"allocs_per_op\":%.2f,\"ns_per_op\":%.1f}\n",
+            name, lookups, bytes, static_cast<double>(allocs) / lookups,
+            static_cast<double>(elapsed) / lookups);
+    fflush(stdout);
+}
+
+void bench_uri_parser(const std::vector<std::string> &targets, size_t lookups)
+{
+    const std::string host = "api.example.com:8888";
+    size_t n = targets.size();
+    size_t bytes = 0;
+    size_t strdups = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        std::string request_uri = "http://" + host + targets[i & (n - 1)];
+        ParsedURI uri;
+        if (URIParser::parse(request_uri, uri) < 0)
+            continue;
+        strdups += parsed_uri_fields(uri);
+        bytes += uri.path ? strlen(uri.path) : 1;
+    }
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs + strdups;
+    report("uri_parser", lookups, bytes, allocs, elapsed);
+}
+
+void bench_parse_target(const std::vector<std::string> &targets, size_t lookups)
+{
+    size_t n = targets.size();
+    size_t bytes = 0;
+    size_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < lookups; i++)
+    {
+        const std::string &t = targets[i & (n - 1)];
+        RequestTarget target;
+        std::unique_ptr<char[]> path_buf;
+        if (UriUtil::parse_target(t.c_str(), t.size(), target, path_buf) < 0)
+            continue;
+        bytes += target.path.size();
+    }
+    uint64_t elapsed = now_ns() - start;
+    allocs = g_allocs.load(std::memory_order_relaxed) - allocs;
+    report("parse_target", lookups, bytes, allocs, elapsed);
+}
+
+}  // namespace
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char **argv)
+{
+    size_t lookups = 1000000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "lookups=", 8) == 0)
+        {
+            lookups = strtoul(argv[i] + 8, nullptr, 10);
+        } else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (lookups == 0)
+        lookups = 1;
+
+    std::mt19937 rng(42);
+    std::vector<std::string> targets = gen_targets(1 << 12, rng);
+    bench_uri_parser(targets, lookups);
+    bench_parse_target(targets, lookups);
+    return 0;
+}
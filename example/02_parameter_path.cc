@@ -21,8 +21,8 @@ int main()
     // curl -v "ip:port/user/chanchan/"
     svr.GET("/user/{name}", [](const HttpReq *req, HttpResp *resp)
     {
-        // reference : no copy
-        const std::string& name = req->param("name");
+        // param() is a view into the request path : no copy
+        std::string name = req->param("name").as_string();
         // resp->set_status(HttpStatusOK); // automatically
         resp->String("Hello " + name + "\n");
     });
@@ -30,8 +30,8 @@ int main()
     // wildcast/chanchan/action... (prefix)
     svr.GET("/wildcast/{name}/action*", [](const HttpReq *req, HttpResp *resp)
     {
-        const std::string& name = req->param("name");
-        const std::string& match_path = req->match_path();
+        std::string name = req->param("name").as_string();
+        std::string match_path = req->match_path().as_string();
 
         resp->String("[name : " + name + "] [match path : " + match_path + "]\n");
     });
@@ -44,11 +44,11 @@ int main()
         // current_path : /user/chanchan/match1234
         // match_path: match1234
         const std::string &full_path = req->full_path();
-        const std::string &current_path = req->current_path();
+        StringPiece current_path = req->current_path();
         std::string res;
         if (full_path == "/user/{name}/match*")
         {
-            res = full_path + " match : " + current_path;
+            res = full_path + " match : " + current_path.as_string();
         } else
         {
             res = full_path + " dosen't match";
@@ -59,8 +59,8 @@ int main()
     svr.GET("/public/*", [](const HttpReq *req, HttpResp *resp)
     {
         fprintf(stderr, "full_path : %s\n", req->full_path().c_str());
-        fprintf(stderr, "current_path : %s\n", req->current_path().c_str());
-        fprintf(stderr, "current_path : %s\n", req->match_path().c_str());
+        fprintf(stderr, "current_path : %s\n", req->current_path().as_string().c_str());
+        fprintf(stderr, "match_path : %s\n", req->match_path().as_string().c_str());
     });
 
     // This handler will add a new router for /user/groups.
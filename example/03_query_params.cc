@@ -21,10 +21,10 @@ int main()
     // The request responds to a url matching:  /query_list?username=chanchann&password=yyy
     svr.GET("/query_list", [](const HttpReq *req, HttpResp *resp)
     {
-        const std::map<std::string, std::string>& query_list = req->query_list();
+        const QueryParams &query_list = req->query_list();
         for (auto &query: query_list)
         {
-            fprintf(stderr, "%s : %s\n", query.first.c_str(), query.second.c_str());
+            fprintf(stderr, "%s : %s\n", query.key.as_string().c_str(), query.value.as_string().c_str());
         }
     });
 
@@ -32,14 +32,14 @@ int main()
     svr.GET("/query", [](const HttpReq *req, HttpResp *resp)
     {
         // 自己 test
-        const std::map<std::string, std::string>& query_lsit = req->query_list();
+        const QueryParams &query_lsit = req->query_list();
         
         for(auto& query : query_lsit) 
         {
-            const std::string& user_name = req->query(query.first.c_str());
-            const std::string& password = req->query("password");
-            const std::string& info = req->query("info"); // no this field
-            const std::string& address = req->default_query("address", "china");
+            std::string user_name = req->query(query.key).as_string();
+            std::string password = req->query("password").as_string();
+            std::string info = req->query("info").as_string(); // no this field
+            std::string address = req->default_query("address", "china").as_string();
             resp->String(user_name + " " + password + " " + info + " " + address + "\n");
         }
     
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "Arena.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+std::atomic<size_t> g_mallocs{0};
+
+void *checked_malloc(size_t size)
+{
+    void *p = malloc(size);
+    if (!p)
+        abort();
+    g_mallocs.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+inline char *align_up(char *p, size_t align)
+{
+    return reinterpret_cast<char *>(
+            (reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+}  // namespace
+
+// The chunks other threads give back to one, pushed onto a stack it takes
+// whole. Outlives its thread as long as chunks of it are still out.
+struct Arena::Remote
+{
+    std::atomic<Chunk *> head{nullptr};     // closed() once the thread is gone
+    std::atomic<long> orphans{0};           // out when it closed, minus freed since
+
+    static Chunk *closed()
+    { return reinterpret_cast<Chunk *>(1); }
+};
+
+struct Arena::FreeList
+{
+    Chunk *head = nullptr;
+    size_t size = 0;
+    size_t out = 0;     // taken and not back yet
+    Remote *remote = new Remote;
+
+    void put(Chunk *chunk)
+    {
+        out--;
+        if (size < k_max_free_chunks)
+        {
+            chunk->next = head;
+            head = chunk;
+            size++;
+        } else
+        {
+            free(chunk);
+        }
+    }
+
+    ~FreeList()
+    {
+        while (head)
+        {
+            Chunk *next = head->next;
+            free(head);
+            head = next;
+        }
+        Chunk *back = remote->head.exchange(Remote::closed(), std::memory_order_acquire);
+        while (back)
+        {
+            Chunk *next = back->next;
+            free(back);
+            out--;
+            back = next;
+        }
+        // the last of the chunks still out deletes it, see give_chunk()
+        long n = static_cast<long>(out);
+        if (remote->orphans.fetch_add(n, std::memory_order_acq_rel) + n == 0)
+            delete remote;
+    }
+};
+
+Arena::FreeList &Arena::free_list()
+{
+    static thread_local FreeList list;
+    return list;
+}
+
+Arena::Chunk *Arena::take_chunk()
+{
+    FreeList &list = free_list();
+    if (!list.head && list.remote->head.load(std::memory_order_relaxed))
+    {
+        // all kept, past k_max_free_chunks too : they are as many as the
+        // requests of this thread another one was done with
+        Chunk *back = list.remote->head.exchange(nullptr, std::memory_order_acquire);
+        while (back)
+        {
+            Chunk *next = back->next;
+            back->next = list.head;
+            list.head = back;
+            list.size++;
+            list.out--;
+            back = next;
+        }
+    }
+
+    Chunk *chunk = list.head;
+    if (chunk)
+    {
+        list.head = chunk->next;
+        list.size--;
+    } else
+    {
+        chunk = static_cast<Chunk *>(checked_malloc(k_chunk_size));
+    }
+    list.out++;
+    chunk->next = nullptr;
+    chunk->owner = list.remote;
+    chunk->pooled = true;
+    return chunk;
+}
+
+void Arena::give_chunk(Chunk *chunk)
+{
+    FreeList &list = free_list();
+    if (chunk->owner == list.remote)
+    {
+        list.put(chunk);
+        return;
+    }
+
+    // back to the thread it was taken on
+    Remote *remote = chunk->owner;
+    Chunk *head = remote->head.load(std::memory_order_relaxed);
+    do
+    {
+        if (head == Remote::closed())
+        {
+            free(chunk);
+            if (remote->orphans.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete remote;
+            return;
+        }
+        chunk->next = head;
+    } while (!remote->head.compare_exchange_weak(head, chunk, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+}
+
+Arena::Arena(Chunk *first)
+    : chunks_(first),
+      pos_(reinterpret_cast<char *>(this + 1)),
+      end_(reinterpret_cast<char *>(first) + k_chunk_size)
+{}
+
+Arena *Arena::create()
+{
+    Chunk *first = take_chunk();
+    char *p = align_up(reinterpret_cast<char *>(first + 1), alignof(Arena));
+    return new (p) Arena(first);
+}
+
+void Arena::destroy(Arena *arena)
+{
+    if (!arena)
+        return;
+
+    // the arena itself is in the last of them
+    Chunk *chunk = arena->chunks_;
+    while (chunk)
+    {
+        Chunk *next = chunk->next;
+        if (chunk->pooled)
+            give_chunk(chunk);
+        else
+            free(chunk);
+        chunk = next;
+    }
+}
+
+void *Arena::allocate_slow(size_t size, size_t align)
+{
+    // big ones would leave most of a chunk unused
+    if (size + align > k_chunk_size / 2)
+    {
+        Chunk *block = static_cast<Chunk *>(checked_malloc(sizeof(Chunk) + size + align));
+        block->pooled = false;
+        block->next = chunks_->next;
+        chunks_->next = block;
+        return align_up(reinterpret_cast<char *>(block + 1), align);
+    }
+
+    Chunk *chunk = take_chunk();
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    pos_ = reinterpret_cast<char *>(chunk + 1);
+    end_ = reinterpret_cast<char *>(chunk) + k_chunk_size;
+    return allocate(size, align);
+}
+
+size_t Arena::mallocs()
+{
+    return g_mallocs.load(std::memory_order_relaxed);
+}
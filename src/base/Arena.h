@@ -0,0 +1,148 @@
+#ifndef WFREST_ARENA_H_
+#define WFREST_ARENA_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "Noncopyable.h"
+
+namespace wfrest
+{
+
+// A bump allocator for what lives as long as one request.
+// Memory comes in k_chunk_size chunks, taken from a free list of the
+// calling thread and handed back to that same free list wherever the arena
+// is destroyed, so a warm server thread does not malloc for it : a request
+// read on a network thread and done with on a handler thread sends its
+// chunks back to the network thread. Those of a thread that has exited are
+// freed.
+// Nothing is freed one by one : it all goes at once in destroy().
+// Not thread safe, like the request it belongs to.
+class Arena : public Noncopyable
+{
+public:
+    static const size_t k_chunk_size = 4096;
+
+    // chunks kept per thread, past that the ones it gives back itself go
+    // back to malloc, see take_chunk()
+    static const size_t k_max_free_chunks = 64;
+
+    // The arena lives at the start of its own first chunk
+    static Arena *create();
+
+    // nullptr is fine
+    static void destroy(Arena *arena);
+
+    // Never nullptr. Past half a chunk it gets a block of its own.
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    // chunks and big blocks got from malloc by this process so far
+    static size_t mallocs();
+
+private:
+    struct Remote;
+
+    struct Chunk
+    {
+        Chunk *next;
+        Remote *owner;  // of the thread it was taken on
+        bool pooled;    // k_chunk_size, goes back to a free list
+    };
+
+    struct FreeList;
+
+    static FreeList &free_list();
+
+    explicit Arena(Chunk *first);
+
+    void *allocate_slow(size_t size, size_t align);
+
+    static Chunk *take_chunk();
+
+    static void give_chunk(Chunk *chunk);
+
+private:
+    Chunk *chunks_;     // the current one first
+    char *pos_;
+    char *end_;
+};
+
+struct ArenaDeleter
+{
+    void operator()(Arena *arena) const
+    { Arena::destroy(arena); }
+};
+
+using ArenaPtr = std::unique_ptr<Arena, ArenaDeleter>;
+
+inline void *Arena::allocate(size_t size, size_t align)
+{
+    char *p = reinterpret_cast<char *>(
+            (reinterpret_cast<uintptr_t>(pos_) + align - 1) & ~(uintptr_t)(align - 1));
+    if (p + size <= end_ && p >= pos_)
+    {
+        pos_ = p + size;
+        return p;
+    }
+    return allocate_slow(size, align);
+}
+
+// For the std containers of a request. Without an arena it is the
+// plain operator new, so they still work default constructed.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    // a copy keeps the arena it has, a move takes the other one
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() : arena_(nullptr)
+    {}
+
+    explicit ArenaAllocator(Arena *arena) : arena_(arena)
+    {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena())
+    {}
+
+    T *allocate(size_t n)
+    {
+        if (arena_)
+            return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    // in an arena it waits for Arena::destroy()
+    void deallocate(T *p, size_t)
+    {
+        if (!arena_)
+            ::operator delete(p);
+    }
+
+    Arena *arena() const
+    { return arena_; }
+
+private:
+    Arena *arena_;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+{ return lhs.arena() == rhs.arena(); }
+
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+{ return lhs.arena() != rhs.arena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace wfrest
+
+#endif // WFREST_ARENA_H_
@@ -1,5 +1,7 @@
 
 #include <cassert>
+#include <cstring>
+#include <strings.h>
 #include "Compress.h"
 #include "ErrorCode.h"
 
@@ -11,12 +13,47 @@ const char* compress_method_to_str(const Compress& compress_method)
     {
         case Compress::GZIP:
             return "gzip";
+        case Compress::DEFLATE:
+            return "deflate";
         default:
             return "unsupport compression";
     }
 }
+
+bool str_to_compress_method(const char *str, size_t len, Compress &compress_method)
+{
+    while (len > 0 && (*str == ' ' || *str == '\t'))
+    {
+        str++;
+        len--;
+    }
+    while (len > 0 && (str[len - 1] == ' ' || str[len - 1] == '\t'))
+        len--;
+
+    if ((len == 4 && strncasecmp(str, "gzip", 4) == 0) ||
+        (len == 6 && strncasecmp(str, "x-gzip", 6) == 0))
+    {
+        compress_method = Compress::GZIP;
+        return true;
+    }
+    if (len == 7 && strncasecmp(str, "deflate", 7) == 0)
+    {
+        compress_method = Compress::DEFLATE;
+        return true;
+    }
+    return false;
+}
 }  // namespace wfrest
 
+namespace
+{
+
+const size_t k_inflate_chunk = 16 * 1024;
+
+int compress_with(int window_bits, const char *data, const size_t len, std::string *dest);
+
+}  // namespace
+
 using namespace wfrest;
 
 int Compressor::gzip(const std::string * const src, std::string *dest)
@@ -26,7 +63,10 @@ int Compressor::gzip(const std::string * const src, std::string *dest)
     return gzip(data, len, dest);
 }
 
-int Compressor::gzip(const char *data, const size_t len, std::string *dest)
+namespace
+{
+
+int compress_with(int window_bits, const char *data, const size_t len, std::string *dest)
 {
     dest->clear();
     z_stream strm = {nullptr,
@@ -48,7 +88,7 @@ int Compressor::gzip(const char *data, const size_t len, std::string *dest)
         if (deflateInit2(&strm,
                          Z_DEFAULT_COMPRESSION,  
                          Z_DEFLATED,
-                         MAX_WBITS + 16,
+                         window_bits,
                          8,
                          Z_DEFAULT_STRATEGY) != Z_OK)
         {
@@ -69,7 +109,7 @@ int Compressor::gzip(const char *data, const size_t len, std::string *dest)
             assert(outstr.size() >= strm.total_out);
             strm.avail_out = static_cast<uInt>(outstr.size() - strm.total_out);
             strm.next_out = (Bytef *)outstr.data() + strm.total_out;
-            ret = deflate(&strm, Z_FINISH); /* no bad return value */
+            ret = ::deflate(&strm, Z_FINISH); /* no bad return value */
             if (ret == Z_STREAM_ERROR)
             {
                 (void)deflateEnd(&strm);
@@ -86,6 +126,19 @@ int Compressor::gzip(const char *data, const size_t len, std::string *dest)
     }
     return StatusCompressError;
 }
+
+}  // namespace
+
+int Compressor::gzip(const char *data, const size_t len, std::string *dest)
+{
+    return compress_with(MAX_WBITS + 16, data, len, dest);
+}
+
+int Compressor::deflate(const char *data, const size_t len, std::string *dest)
+{
+    return compress_with(MAX_WBITS, data, len, dest);
+}
+
 int Compressor::ungzip(const std::string * const src, std::string *dest)
 {
     const char *data = src->c_str();
@@ -94,74 +147,133 @@ int Compressor::ungzip(const std::string * const src, std::string *dest)
 }
 
 int Compressor::ungzip(const char *data, const size_t len, std::string *dest)
+{
+    return inflate(Compress::GZIP, data, len, static_cast<size_t>(-1), dest);
+}
+
+int Compressor::inflate(Compress method, const char *data, const size_t len,
+                        size_t max_size, std::string *dest)
 {
     dest->clear();
     if (len == 0)
         return StatusOK;
 
-    auto full_length = len;
+    Inflater inflater;
+    int status = inflater.init(method, max_size);
+    if (status != StatusOK)
+        return status;
 
-    auto decompressed = std::string(full_length * 2, 0);
-    bool done = false;
+    // ISIZE can lie, it is only trusted up to max_size
+    size_t hint = Inflater::gzip_size_hint(data, len);
+    if (hint == 0)
+        hint = len * 2;
+    dest->reserve(hint < max_size ? hint : max_size);
 
-    z_stream strm = {nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     0,
-                     0,
-                     0};
-    strm.next_in = (Bytef *)data;
-    strm.avail_in = static_cast<uInt>(len);
-    strm.total_out = 0;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    if (inflateInit2(&strm, (15 + 32)) != Z_OK)
+    status = inflater.feed(data, len, [dest](const char *out, size_t out_len) -> int
     {
-        // fprintf(stderr, "inflateInit2 error!\n");
-        return StatusUncompressError;
-    }
-    while (!done)
+        dest->append(out, out_len);
+        return StatusOK;
+    });
+    if (status == StatusOK)
+        status = inflater.finish();
+    if (status != StatusOK)
+        dest->clear();
+    return status;
+}
+
+Inflater::Inflater()
+    : method_(Compress::GZIP),
+      started_(false),
+      done_(false),
+      error_(StatusUncompressError),
+      max_size_(0),
+      total_out_(0)
+{
+    memset(&strm_, 0, sizeof strm_);
+}
+
+Inflater::~Inflater()
+{
+    if (started_)
+        inflateEnd(&strm_);
+}
+
+int Inflater::init(Compress method, size_t max_size)
+{
+    if (method != Compress::GZIP && method != Compress::DEFLATE)
+        return StatusUncompressNotSupport;
+    method_ = method;
+    max_size_ = max_size;
+    error_ = StatusOK;
+    return StatusOK;
+}
+
+// the window bits depend on the first bytes for deflate
+int Inflater::start(const char *data, size_t len)
+{
+    int window_bits = MAX_WBITS + 32;   // gzip or zlib, from the header
+    if (method_ == Compress::DEFLATE && len >= 2)
     {
-        // Make sure we have enough room and reset the lengths.
-        if (strm.total_out >= decompressed.length())
-        {
-            decompressed.resize(decompressed.length() * 2);
-        }
-        strm.next_out = (Bytef *)decompressed.data() + strm.total_out;
-        strm.avail_out =
-                static_cast<uInt>(decompressed.length() - strm.total_out);
-        // Inflate another chunk.
-        int status = inflate(&strm, Z_SYNC_FLUSH);
-        if (status == Z_STREAM_END)
-        {
-            done = true;
-        }
-        else if (status != Z_OK)
-        {
-            break;
-        }
+        unsigned char cmf = data[0];
+        unsigned char flg = data[1];
+        if ((cmf & 0x0f) != Z_DEFLATED || (cmf * 256 + flg) % 31 != 0)
+            window_bits = -MAX_WBITS;   // no zlib header, raw deflate
     }
-    if (inflateEnd(&strm) != Z_OK)
+    if (inflateInit2(&strm_, window_bits) != Z_OK)
         return StatusUncompressError;
-    // Set real length.
-    int status = StatusOK;
-    if (done)
-    {
-        decompressed.resize(strm.total_out);
-        *dest = std::move(decompressed);
-    }
-    else
+    started_ = true;
+    return StatusOK;
+}
+
+int Inflater::feed(const char *data, size_t len, const Sink &sink)
+{
+    if (error_ != StatusOK)
+        return error_;
+    if (done_ || len == 0)
+        return StatusOK;
+    if (!started_ && (error_ = start(data, len)) != StatusOK)
+        return error_;
+
+    unsigned char out[k_inflate_chunk];
+    strm_.next_in = (Bytef *)data;
+    strm_.avail_in = static_cast<uInt>(len);
+    do
     {
-        status = StatusUncompressError;
-    }
-    return status;
+        strm_.next_out = out;
+        strm_.avail_out = sizeof out;
+        int ret = ::inflate(&strm_, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            return error_ = StatusUncompressError;
+
+        size_t n = sizeof out - strm_.avail_out;
+        if (n > max_size_ - total_out_)
+            return error_ = StatusUncompressTooLarge;
+        total_out_ += n;
+        if (n > 0 && (error_ = sink(reinterpret_cast<const char *>(out), n)) != StatusOK)
+            return error_;
+
+        if (ret == Z_STREAM_END)
+            done_ = true;
+        else if (ret == Z_BUF_ERROR)
+            break;      // needs more input
+    } while (!done_ && (strm_.avail_in > 0 || strm_.avail_out == 0));
+    return StatusOK;
 }
 
+int Inflater::finish() const
+{
+    if (error_ != StatusOK)
+        return error_;
+    return done_ ? StatusOK : StatusUncompressError;
+}
+
+size_t Inflater::gzip_size_hint(const char *data, size_t len)
+{
+    // 10 bytes header, 8 bytes trailer
+    if (len < 18 || static_cast<unsigned char>(data[0]) != 0x1f ||
+        static_cast<unsigned char>(data[1]) != 0x8b)
+        return 0;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data + len - 4);
+    return static_cast<size_t>(p[0]) | static_cast<size_t>(p[1]) << 8 |
+           static_cast<size_t>(p[2]) << 16 | static_cast<size_t>(p[3]) << 24;
+}
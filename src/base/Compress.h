@@ -5,18 +5,67 @@
 #define WFREST_COMPRESS_H_
 
 #include <string>
+#include <functional>
 #include <zlib.h>
+#include "Noncopyable.h"
 
 namespace wfrest
 {
 
 enum class Compress 
 {
-    GZIP
+    GZIP,
+    DEFLATE,
 };
 
 const char* compress_method_to_str(const Compress& compress_method);
 
+// Content-Encoding value to method, false for identity or anything unsupported
+bool str_to_compress_method(const char *str, size_t len, Compress &compress_method);
+
+// Streaming gzip / deflate decoder with a cap on the decoded size.
+// feed() takes the stream in pieces as they arrive and hands every
+// decoded chunk to the sink, so nothing has to hold the whole output.
+class Inflater : public Noncopyable
+{
+public:
+    // anything but StatusOK stops the stream and is returned by feed()
+    using Sink = std::function<int(const char *data, size_t len)>;
+
+    Inflater();
+
+    ~Inflater();
+
+    // "deflate" is the zlib format, raw deflate is accepted too as some
+    // clients send that. StatusUncompressTooLarge once more than max_size
+    // bytes come out.
+    int init(Compress method, size_t max_size);
+
+    int feed(const char *data, size_t len, const Sink &sink);
+
+    // StatusUncompressError if the stream was cut short
+    int finish() const;
+
+    size_t total_out() const
+    { return total_out_; }
+
+    // ISIZE trailer of a gzip stream : the decoded size mod 2^32, of the
+    // last member only, so a hint. 0 if data is not gzip.
+    static size_t gzip_size_hint(const char *data, size_t len);
+
+private:
+    int start(const char *data, size_t len);
+
+private:
+    z_stream strm_;
+    Compress method_;
+    bool started_;
+    bool done_;
+    int error_;
+    size_t max_size_;
+    size_t total_out_;
+};
+
 class Compressor
 {
 public:
@@ -27,6 +76,13 @@ public:
     static int ungzip(const std::string * const src, std::string *dest);
     
     static int ungzip(const char *data, const size_t len, std::string *dest);
+
+    // zlib format
+    static int deflate(const char *data, const size_t len, std::string *dest);
+
+    // through an Inflater, dest is sized from the gzip trailer up front
+    static int inflate(Compress method, const char *data, const size_t len,
+                       size_t max_size, std::string *dest);
 };
 
 }  // namespace wfrest
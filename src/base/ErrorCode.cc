@@ -12,14 +12,19 @@ std::map<int, const char *> error_code_table = {
     { StatusUncompressError, "Uncompress Error" },
     { StatusUncompressNotSupport, "Uncompress Not Support" },
     { StatusNoUncomrpess, "No Uncomrpess" },
+    { StatusUncompressTooLarge, "Uncompressed Body Too Large" },
+    { StatusRequestJsonInvalid, "Request Json Invalid" },
+    { StatusFormInvalid, "Form Invalid" },
     { StatusNotFound, "404 Not Found" },
     { StatusFileRangeInvalid, "File Range Invalid" },
     { StatusFileReadError, "File Read Error" },
     { StatusFileWriteError, "File Write Error" },
+    { StatusBodySpilled, "Body Spilled, Use body_view()" },
     { StatusJsonInvalid, "Invalid Json Syntax" },
     { StatusProxyError, "Http Proxy Error" },
     { StatusRouteVerbNotImplment, "Route Http Method not implement" },
     { StatusRouteNotFound, "Route Not Found" },
+    { StatusRouteParamInvalid, "Route Param Invalid" },
 };
  
 const char* error_code_to_str(int code)
@@ -15,20 +15,27 @@ enum ErrorCode
     StatusUncompressError,
     StatusUncompressNotSupport,
     StatusNoUncomrpess,
+    StatusUncompressTooLarge,
 
     // File
     StatusFileRangeInvalid,
     StatusFileReadError,
     StatusFileWriteError,
+    StatusBodySpilled,
 
     // Json
     StatusJsonInvalid,
+    StatusRequestJsonInvalid,
+
+    // Form
+    StatusFormInvalid,
     
     StatusProxyError,
 
     // Route
     StatusRouteVerbNotImplment,
     StatusRouteNotFound,
+    StatusRouteParamInvalid,
 };
 
 const char* error_code_to_str(int code);
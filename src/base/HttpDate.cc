@@ -0,0 +1,178 @@
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+#include "HttpDate.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+const char k_week_days[] = "SunMonTueWedThuFriSat";
+const char k_months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+inline void put2(char *p, int v)
+{
+    p[0] = static_cast<char>('0' + v / 10);
+    p[1] = static_cast<char>('0' + v % 10);
+}
+
+inline void put4(char *p, int v)
+{
+    put2(p, v / 100);
+    put2(p + 2, v % 100);
+}
+
+// days since 1970-01-01 to a date, http://howardhinnant.github.io/date_algorithms.html
+void civil_from_days(int64_t z, int &y, int &m, int &d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast<int>(static_cast<int64_t>(yoe) + era * 400 + (m <= 2));
+}
+
+const size_t k_second_len = HttpDate::k_date_len + HttpDate::k_log_len;
+
+// now() then now_log() of one second
+void format_second(time_t sec, char *buf)
+{
+    HttpDate::format(sec, buf);
+
+    // once a second, the tz lock does not matter
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char *log = buf + HttpDate::k_date_len;
+    put4(log, tm.tm_year + 1900);
+    log[4] = '-';
+    put2(log + 5, tm.tm_mon + 1);
+    log[7] = '-';
+    put2(log + 8, tm.tm_mday);
+    log[10] = ' ';
+    put2(log + 11, tm.tm_hour);
+    log[13] = ':';
+    put2(log + 14, tm.tm_min);
+    log[16] = ':';
+    put2(log + 17, tm.tm_sec);
+}
+
+// One formatted second. Written as atomic words behind sec, like a
+// seqlock : a reader racing the writer sees sec change and retries.
+struct Slot
+{
+    static const size_t k_words = (k_second_len + 7) / 8;
+
+    std::atomic<int64_t> sec{-1};
+    std::atomic<uint64_t> words[k_words];
+};
+
+// a slot is rewritten k_slots seconds after it was current
+const size_t k_slots = 8;
+
+Slot g_slots[k_slots];
+std::atomic<Slot *> g_current{&g_slots[0]};
+std::mutex g_mutex;     // the writer
+size_t g_next = 1;
+
+bool read_slot(const Slot *slot, int64_t sec, char *buf)
+{
+    if (slot->sec.load(std::memory_order_acquire) != sec)
+        return false;
+
+    uint64_t words[Slot::k_words];
+    for (size_t i = 0; i < Slot::k_words; i++)
+        words[i] = slot->words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sec.load(std::memory_order_relaxed) != sec)
+        return false;
+
+    memcpy(buf, words, k_second_len);
+    return true;
+}
+
+// g_mutex held
+void publish(int64_t sec, const char *buf)
+{
+    uint64_t words[Slot::k_words] = {0};
+    memcpy(words, buf, k_second_len);
+
+    Slot *slot = &g_slots[g_next];
+    g_next = (g_next + 1) % k_slots;
+    slot->sec.store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < Slot::k_words; i++)
+        slot->words[i].store(words[i], std::memory_order_relaxed);
+    slot->sec.store(sec, std::memory_order_release);
+    g_current.store(slot, std::memory_order_release);
+}
+
+void current_second(char *buf)
+{
+    time_t now = ::time(nullptr);
+    int64_t sec = static_cast<int64_t>(now);
+    if (read_slot(g_current.load(std::memory_order_acquire), sec, buf))
+        return;
+
+    // The first ones of a second format it themselves, one of them keeps
+    // it for the others. Nobody waits for the lock.
+    format_second(now, buf);
+    std::unique_lock<std::mutex> lock(g_mutex, std::try_to_lock);
+    if (lock.owns_lock() &&
+        g_current.load(std::memory_order_relaxed)->sec.load(std::memory_order_relaxed) != sec)
+        publish(sec, buf);
+}
+
+}  // namespace
+
+void HttpDate::now(OUT char *date)
+{
+    char buf[k_second_len];
+    current_second(buf);
+    memcpy(date, buf, k_date_len);
+}
+
+void HttpDate::now_log(OUT char *log)
+{
+    char buf[k_second_len];
+    current_second(buf);
+    memcpy(log, buf + k_date_len, k_log_len);
+}
+
+void HttpDate::format(time_t sec, OUT char *date)
+{
+    int64_t t = static_cast<int64_t>(sec);
+    int64_t days = t / 86400;
+    int64_t rem = t % 86400;
+    if (rem < 0)
+    {
+        rem += 86400;
+        days--;
+    }
+    int y, m, d;
+    civil_from_days(days, y, m, d);
+    int week_day = static_cast<int>((days % 7 + 11) % 7);     // 1970-01-01 was a Thursday
+    int secs = static_cast<int>(rem);
+
+    memcpy(date, k_week_days + 3 * week_day, 3);
+    date[3] = ',';
+    date[4] = ' ';
+    put2(date + 5, d);
+    date[7] = ' ';
+    memcpy(date + 8, k_months + 3 * (m - 1), 3);
+    date[11] = ' ';
+    put4(date + 12, y);
+    date[16] = ' ';
+    put2(date + 17, secs / 3600);
+    date[19] = ':';
+    put2(date + 20, secs / 60 % 60);
+    date[22] = ':';
+    put2(date + 23, secs % 60);
+    memcpy(date + 25, " GMT", 4);
+}
@@ -0,0 +1,43 @@
+#ifndef WFREST_HTTPDATE_H_
+#define WFREST_HTTPDATE_H_
+
+#include <ctime>
+#include <string>
+#include "Macro.h"
+
+namespace wfrest
+{
+
+// Dates the way HTTP writes them, without strftime, locales or streams.
+// The current time is formatted once a second for the whole process and
+// read lock free by every thread after that.
+class HttpDate
+{
+public:
+    // RFC 7231 IMF-fixdate, always GMT : "Sun, 06 Nov 1994 08:49:37 GMT"
+    static const size_t k_date_len = 29;
+
+    // local time, for access logs : "1994-11-06 09:49:37"
+    static const size_t k_log_len = 19;
+
+    // The Date header of a response. k_date_len bytes, no '\0'.
+    static void now(OUT char *date);
+
+    // the same second as now(), local time. k_log_len bytes, no '\0'.
+    static void now_log(OUT char *log);
+
+    // Any time, e.g. Last-Modified from st_mtime or the Expires of a
+    // cookie. k_date_len bytes, no '\0'.
+    static void format(time_t sec, OUT char *date);
+
+    static std::string format(time_t sec)
+    {
+        char date[k_date_len];
+        format(sec, date);
+        return std::string(date, k_date_len);
+    }
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_HTTPDATE_H_
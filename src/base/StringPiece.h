@@ -8,6 +8,7 @@
 
 #include <cstring>
 #include <string>
+#include <algorithm>
 
 namespace wfrest
 {
@@ -165,6 +166,15 @@ public:
         target->assign(ptr_, length_);
     }
 
+    // offset of the first "x" in "this", std::string::npos if none
+    size_t find(const StringPiece &x) const
+    {
+        const char *p = std::search(begin(), end(), x.begin(), x.end());
+        if (p == end() && x.length_ > 0)
+            return std::string::npos;
+        return p - ptr_;
+    }
+
     // Does "this" start with "x"
     bool starts_with(const StringPiece &x) const
     {
@@ -288,6 +288,48 @@ void BluePrint::HEAD(const char *route, int compute_queue_id, const SeriesHandle
     this->ROUTE(route, compute_queue_id, handler, Verb::HEAD);
 }
 
+void BluePrint::POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                            const StreamChunkHandler &on_chunk, const Handler &on_end)
+{
+    this->POST(route, on_end);
+    this->set_stream(route, -1, on_headers, on_chunk);
+}
+
+void BluePrint::POST_STREAM(const char *route, int compute_queue_id,
+                            const StreamHeadersHandler &on_headers,
+                            const StreamChunkHandler &on_chunk, const Handler &on_end)
+{
+    this->POST(route, compute_queue_id, on_end);
+    this->set_stream(route, compute_queue_id, on_headers, on_chunk);
+}
+
+void BluePrint::POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                            const StreamChunkHandler &on_chunk, const SeriesHandler &on_end)
+{
+    this->POST(route, on_end);
+    this->set_stream(route, -1, on_headers, on_chunk);
+}
+
+void BluePrint::POST_STREAM(const char *route, int compute_queue_id,
+                            const StreamHeadersHandler &on_headers,
+                            const StreamChunkHandler &on_chunk, const SeriesHandler &on_end)
+{
+    this->POST(route, compute_queue_id, on_end);
+    this->set_stream(route, compute_queue_id, on_headers, on_chunk);
+}
+
+void BluePrint::set_stream(const char *route, int compute_queue_id,
+                           const StreamHeadersHandler &on_headers,
+                           const StreamChunkHandler &on_chunk)
+{
+    std::shared_ptr<StreamRoute> stream = std::make_shared<StreamRoute>();
+    stream->verb = Verb::POST;
+    stream->compute_queue_id = compute_queue_id;
+    stream->on_headers = on_headers;
+    stream->on_chunk = on_chunk;
+    router_.route_options(route).stream = std::move(stream);
+}
+
 void BluePrint::add_blueprint(const BluePrint &bp, const std::string &url_prefix)
 {
     bp.router_.routes_map_.all_routes([this, &url_prefix]
@@ -10,6 +10,7 @@
 // todo : hide
 #include "Router.h"
 #include "HttpServerTask.h" 
+#include "TypedRoute.h"
 
 class SeriesWork;
 namespace wfrest
@@ -209,11 +210,92 @@ public:
              const SeriesHandler &handler, const AP &... ap);
 
 public:
+    // Typed params, see TypedRoute.h
+    // bp.GET<int, uint64_t>("/user/{id}/post/{pid}", handler)
+    template<typename T, typename... Args>
+    void ROUTE(const char *route,
+               const typename TypedHandler<T, Args...>::type &handler, Verb verb);
+
+    template<typename T, typename... Args>
+    void ROUTE(const char *route, int compute_queue_id,
+               const typename TypedHandler<T, Args...>::type &handler, Verb verb);
+
+    template<typename T, typename... Args>
+    void GET(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void GET(const char *route, int compute_queue_id,
+             const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void POST(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void POST(const char *route, int compute_queue_id,
+              const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void DELETE(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void DELETE(const char *route, int compute_queue_id,
+                const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void PATCH(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void PATCH(const char *route, int compute_queue_id,
+               const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void PUT(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void PUT(const char *route, int compute_queue_id,
+             const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void HEAD(const char *route, const typename TypedHandler<T, Args...>::type &handler);
+
+    template<typename T, typename... Args>
+    void HEAD(const char *route, int compute_queue_id,
+              const typename TypedHandler<T, Args...>::type &handler);
+
+public:
+    // A POST whose body never sits in memory as a whole : on_headers once the
+    // headers are in, on_chunk on the compute queue as the body is read, then
+    // on_end like any handler, with body() empty and body_status() set if
+    // on_headers or on_chunk gave up. See RouteOptions::stream_buffer_limit.
+    void POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const Handler &on_end);
+
+    void POST_STREAM(const char *route, int compute_queue_id,
+                     const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const Handler &on_end);
+
+    void POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const SeriesHandler &on_end);
+
+    void POST_STREAM(const char *route, int compute_queue_id,
+                     const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const SeriesHandler &on_end);
+
+public:
+    // per route settings, kept when the blueprint is registered
+    // e.g. bp.route_options("/upload").max_body_size = 512 * 1024 * 1024;
+    RouteOptions &route_options(const char *route)
+    { return router_.route_options(route); }
+
     const Router &router() const
     { return router_; }
 
     void add_blueprint(const BluePrint &bp, const std::string &url_prefix);
 
+private:
+    void set_stream(const char *route, int compute_queue_id,
+                    const StreamHeadersHandler &on_headers, const StreamChunkHandler &on_chunk);
+
 private:
     Router router_;    // ptr for hiding internel class
     friend class HttpServer;
@@ -439,6 +439,122 @@ void BluePrint::HEAD(const char *route, int compute_queue_id,
     this->ROUTE(route, compute_queue_id, handler, Verb::HEAD, ap...);
 }
 
+namespace detail
+{
+
+// The route and the handler must agree on the number of params, a route
+// that cannot match its handler is a bug that should not get to serve.
+template<typename... Args>
+void check_typed_route(const char *route)
+{
+    static_assert(RouteArgsSupported<typename std::decay<Args>::type...>::value,
+                  "unsupported typed route param");
+
+    size_t count = route_param_count(route);
+    if (count != sizeof...(Args))
+    {
+        fprintf(stderr, "[WFREST] %s : %zu params in route, %zu in handler\n",
+                route, count, sizeof...(Args));
+        abort();
+    }
+}
+
+}  // namespace detail
+
+template<typename T, typename... Args>
+void BluePrint::ROUTE(const char *route,
+                      const typename TypedHandler<T, Args...>::type &handler, Verb verb)
+{
+    detail::check_typed_route<T, Args...>(route);
+    this->ROUTE(route, TypedHandler<T, Args...>::wrap(handler), verb);
+}
+
+template<typename T, typename... Args>
+void BluePrint::ROUTE(const char *route, int compute_queue_id,
+                      const typename TypedHandler<T, Args...>::type &handler, Verb verb)
+{
+    detail::check_typed_route<T, Args...>(route);
+    this->ROUTE(route, compute_queue_id, TypedHandler<T, Args...>::wrap(handler), verb);
+}
+
+template<typename T, typename... Args>
+void BluePrint::GET(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::GET);
+}
+
+template<typename T, typename... Args>
+void BluePrint::GET(const char *route, int compute_queue_id,
+                    const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::GET);
+}
+
+template<typename T, typename... Args>
+void BluePrint::POST(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::POST);
+}
+
+template<typename T, typename... Args>
+void BluePrint::POST(const char *route, int compute_queue_id,
+                     const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::POST);
+}
+
+template<typename T, typename... Args>
+void BluePrint::DELETE(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::DELETE);
+}
+
+template<typename T, typename... Args>
+void BluePrint::DELETE(const char *route, int compute_queue_id,
+                       const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::DELETE);
+}
+
+template<typename T, typename... Args>
+void BluePrint::PATCH(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::PATCH);
+}
+
+template<typename T, typename... Args>
+void BluePrint::PATCH(const char *route, int compute_queue_id,
+                      const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::PATCH);
+}
+
+template<typename T, typename... Args>
+void BluePrint::PUT(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::PUT);
+}
+
+template<typename T, typename... Args>
+void BluePrint::PUT(const char *route, int compute_queue_id,
+                    const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::PUT);
+}
+
+template<typename T, typename... Args>
+void BluePrint::HEAD(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, handler, Verb::HEAD);
+}
+
+template<typename T, typename... Args>
+void BluePrint::HEAD(const char *route, int compute_queue_id,
+                     const typename TypedHandler<T, Args...>::type &handler)
+{
+    this->ROUTE<T, Args...>(route, compute_queue_id, handler, Verb::HEAD);
+}
+
 } // namespace wfrest
 
 
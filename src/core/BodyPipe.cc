@@ -0,0 +1,260 @@
+#include "workflow/WFTaskFactory.h"
+
+#include <unistd.h>
+
+#include "BodyPipe.h"
+#include "SpoolFile.h"
+#include "VerbHandler.h"
+#include "ErrorCode.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+bool read_spool(int fd, std::string &chunk, size_t offset)
+{
+    size_t done = 0;
+    while (done < chunk.size())
+    {
+        ssize_t ret = pread(fd, &chunk[done], chunk.size() - done, offset + done);
+        if (ret <= 0)
+            return false;
+        done += ret;
+    }
+    return true;
+}
+
+}  // namespace
+
+BodyPipe::BodyPipe(HttpReq *req, const std::shared_ptr<const StreamRoute> &route,
+                   size_t buffer_limit, const std::string &spool_dir,
+                   std::atomic<size_t> *spilled_bytes, int status)
+    : req_(req),
+      route_(route),
+      buffer_limit_(buffer_limit),
+      spool_dir_(spool_dir),
+      spilled_bytes_(spilled_bytes),
+      queued_(0),
+      file_read_(0),
+      draining_(false),
+      waiting_(false),
+      handoff_(false),
+      closed_(false),
+      status_(status)
+{
+    if (route_->compute_queue_id >= 0)
+        queue_name_ = "wfrest" + std::to_string(route_->compute_queue_id);
+    else
+        queue_name_ = "wfrest_stream";
+}
+
+BodyPipe::~BodyPipe()
+{
+    // the writes still in flight keep the file, not this
+    if (file_)
+        file_->on_written(nullptr);
+}
+
+// file_ is only set here, on_data() and on_end() read it without mutex_.
+// The spool file is written out of mutex_, a pwrite task that cannot start
+// calls on_spool_written() right away.
+int BodyPipe::on_data(const char *data, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (status_ != StatusOK || closed_)
+        return StatusOK;    // read and dropped, the handler still replies
+
+    if (!file_ && queued_ + len <= buffer_limit_)
+    {
+        // what is queued is not in on_chunk yet, small pieces can still grow
+        if (!queue_.empty() && queue_.back().size() < k_min_chunk)
+            queue_.back().append(data, len);
+        else
+            queue_.emplace_back(data, len);
+        queued_ += len;
+        start_drain();
+        return StatusOK;
+    }
+
+    // workflow cannot stop reading one connection, and the network thread
+    // must not wait for on_chunk : the rest goes to disk, in order
+    if (!file_)
+    {
+        lock.unlock();
+        auto writes = std::make_shared<SpoolWrites>();
+        std::shared_ptr<SpoolFile> file = SpoolFile::create(spool_dir_, writes);
+        if (file)
+            file->on_written([this]() { this->on_spool_written(); });
+
+        lock.lock();
+        if (!file)
+        {
+            status_ = StatusFileWriteError;
+            for (const std::string &piece : queue_)
+                queued_ -= piece.size();
+            queue_.clear();
+            return StatusOK;
+        }
+        writes_ = std::move(writes);
+        file_ = std::move(file);
+    }
+    lock.unlock();
+
+    file_->write(data, len);
+    if (spilled_bytes_)
+        spilled_bytes_->fetch_add(len, std::memory_order_relaxed);
+    return StatusOK;
+}
+
+int BodyPipe::on_end()
+{
+    if (file_)
+        file_->flush();
+    return StatusOK;
+}
+
+int BodyPipe::status() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status_ == StatusOK && file_ && file_->failed())
+        return StatusFileWriteError;
+    return status_;
+}
+
+// The body is in, on_data() is done : once the go task of its own and the
+// spool writes are, the rest is drained from the series the barrier is in.
+SubTask *BodyPipe::create_barrier()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (waiting_)
+    {
+        // nothing runs until a write ends, the series takes over instead
+        waiting_ = false;
+        draining_ = false;
+    }
+    if (!draining_ && queue_.empty() && !writes_)
+        return nullptr;
+
+    handoff_ = true;
+    int count = (draining_ ? 1 : 0) + (writes_ ? 1 : 0);
+    WFCounterTask *barrier = WFTaskFactory::create_counter_task(count,
+        [this](WFCounterTask *task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool unread = !queue_.empty() || (file_ && file_read_ < file_->written());
+        if (unread && !closed_ && status_ == StatusOK)
+            series_of(task)->push_front(
+                WFTaskFactory::create_go_task(queue_name_, &BodyPipe::drain, this, true));
+    });
+    if (draining_)
+        on_drained_ = [barrier]() { barrier->count(); };
+    if (writes_)
+        writes_->when_drained([barrier]() { barrier->count(); });
+    return barrier;
+}
+
+bool BodyPipe::release_later(std::function<void()> release)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    queue_.clear();
+    if (waiting_)
+    {
+        waiting_ = false;
+        draining_ = false;
+    }
+    if (!draining_)
+        return false;
+
+    on_drained_ = std::move(release);
+    return true;
+}
+
+// mutex_ held
+void BodyPipe::start_drain()
+{
+    if (draining_ || queue_.empty())
+        return;
+
+    draining_ = true;
+    WFGoTask *task = WFTaskFactory::create_go_task(queue_name_, &BodyPipe::drain, this, false);
+    task->start();
+}
+
+void BodyPipe::on_spool_written()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if ((draining_ && !waiting_) || handoff_ || closed_ || status_ != StatusOK)
+        return;
+
+    waiting_ = false;
+    draining_ = true;
+    WFGoTask *task = WFTaskFactory::create_go_task(queue_name_, &BodyPipe::drain, this, false);
+    task->start();
+}
+
+// What is queued first, then the spool file as far as it is written.
+void BodyPipe::drain(bool in_series)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (status_ == StatusOK && !closed_ && (in_series || !handoff_))
+    {
+        std::string chunk;
+        size_t from_queue = 0;
+        size_t offset = 0;
+        if (!queue_.empty())
+        {
+            chunk = std::move(queue_.front());
+            queue_.pop_front();
+            from_queue = chunk.size();
+        } else if (file_ && file_read_ < file_->written())
+        {
+            if (file_->failed())
+            {
+                status_ = StatusFileWriteError;
+                break;
+            }
+            size_t len = file_->written() - file_read_;
+            if (len > SpoolFile::k_write_size)
+                len = SpoolFile::k_write_size;
+            offset = file_read_;
+            chunk.resize(len);
+            file_read_ += len;
+        } else
+        {
+            // the rest is not written yet, on_spool_written() takes it up
+            if (file_ && !in_series)
+            {
+                waiting_ = true;
+                return;
+            }
+            break;
+        }
+        lock.unlock();
+
+        int status = StatusOK;
+        if (!from_queue && !read_spool(file_->fd(), chunk, offset))
+            status = StatusFileReadError;
+        if (status == StatusOK)
+            status = route_->on_chunk(req_, chunk.data(), chunk.size());
+
+        lock.lock();
+        queued_ -= from_queue;
+        if (status != StatusOK && status_ == StatusOK)
+        {
+            status_ = status;
+            queue_.clear();
+            queued_ = 0;
+        }
+    }
+    if (in_series)
+        return;
+
+    draining_ = false;
+    std::function<void()> cb = std::move(on_drained_);
+    // this may be gone as soon as the lock is
+    lock.unlock();
+    if (cb)
+        cb();
+}
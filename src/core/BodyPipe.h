@@ -0,0 +1,90 @@
+#ifndef WFREST_BODYPIPE_H_
+#define WFREST_BODYPIPE_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "BodyStream.h"
+
+namespace wfrest
+{
+
+class HttpReq;
+struct StreamRoute;
+class SpoolFile;
+class SpoolWrites;
+
+// Hands the body of a POST_STREAM() request to its on_chunk, in a go task
+// on the route's compute queue, one at a time and in order.
+// The network thread never waits : past buffer_limit bytes not through
+// on_chunk yet, the rest of the body goes to a SpoolFile, and on_chunk gets
+// it back from there once what is in memory went through. A slow on_chunk
+// costs disk, not memory, and still sees the whole body.
+// The series of the request only exists once the body is in, until then
+// the go tasks run on their own, and the request waits for the last of
+// them either way, see create_barrier() and release_later().
+class BodyPipe : public BodyConsumer, public Noncopyable
+{
+public:
+    // pieces smaller than this are put together before on_chunk sees them
+    static const size_t k_min_chunk = 64 * 1024;
+
+    // status : what on_headers returned, anything but StatusOK drops the body
+    // spilled_bytes : what went to the spool file is added there
+    BodyPipe(HttpReq *req, const std::shared_ptr<const StreamRoute> &route,
+             size_t buffer_limit, const std::string &spool_dir,
+             std::atomic<size_t> *spilled_bytes, int status);
+
+    ~BodyPipe();
+
+    int on_data(const char *data, size_t len) override;
+
+    int on_end() override;
+
+    int status() const override;
+
+    // Waits for the on_chunk in flight and the spool writes, what is still
+    // queued or spooled then goes through on_chunk in a go task of the
+    // series of the request.
+    SubTask *create_barrier() override;
+
+    // drops what is queued, an on_chunk in flight calls release
+    bool release_later(std::function<void()> release) override;
+
+private:
+    // in the go task, in_series : pushed by create_barrier()
+    void drain(bool in_series);
+
+    void start_drain();
+
+    // the go task of its own waits for the spool file, see drain()
+    void on_spool_written();
+
+private:
+    HttpReq *req_;
+    std::shared_ptr<const StreamRoute> route_;
+    std::string queue_name_;
+    size_t buffer_limit_;
+    std::string spool_dir_;
+    std::atomic<size_t> *spilled_bytes_;
+
+    mutable std::mutex mutex_;
+    std::deque<std::string> queue_;
+    size_t queued_;                 // bytes in queue_ and in on_chunk
+    std::shared_ptr<SpoolWrites> writes_;
+    std::shared_ptr<SpoolFile> file_;   // the rest of the body, past buffer_limit_
+    size_t file_read_;              // bytes of file_ through on_chunk or in it
+    bool draining_;                 // a go task of its own is on it
+    bool waiting_;                  // that go task is done until a spool write is
+    bool handoff_;                  // that go task stops, see create_barrier()
+    bool closed_;                   // the request is going away
+    int status_;
+    std::function<void()> on_drained_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_BODYPIPE_H_
@@ -0,0 +1,115 @@
+#include "workflow/WFTaskFactory.h"
+
+#include <sys/mman.h>
+
+#include "BodySpill.h"
+#include "SpoolFile.h"
+#include "ErrorCode.h"
+
+using namespace wfrest;
+
+BodySpill::BodySpill(size_t memory_limit, const std::string &spool_dir,
+                     std::atomic<size_t> *spilled_bytes)
+    : memory_limit_(memory_limit),
+      spool_dir_(spool_dir),
+      spilled_bytes_(spilled_bytes),
+      status_(StatusOK),
+      map_(nullptr),
+      map_size_(0)
+{}
+
+BodySpill::~BodySpill()
+{
+    release();
+}
+
+// a body that could not be spooled is read and dropped, see status()
+int BodySpill::on_data(const char *data, size_t len)
+{
+    if (status_ != StatusOK)
+        return StatusOK;
+
+    if (!file_ && data_.size() + len <= memory_limit_)
+    {
+        data_.append(data, len);
+        return StatusOK;
+    }
+
+    if (!file_)
+    {
+        writes_ = std::make_shared<SpoolWrites>();
+        file_ = SpoolFile::create(spool_dir_, writes_);
+        if (!file_)
+        {
+            status_ = StatusFileWriteError;
+            std::string().swap(data_);
+            return StatusOK;
+        }
+        file_->write(data_.data(), data_.size());
+        if (spilled_bytes_)
+            spilled_bytes_->fetch_add(data_.size(), std::memory_order_relaxed);
+        std::string().swap(data_);
+    }
+    file_->write(data, len);
+    if (spilled_bytes_)
+        spilled_bytes_->fetch_add(len, std::memory_order_relaxed);
+    return StatusOK;
+}
+
+int BodySpill::on_end()
+{
+    if (file_)
+        file_->flush();
+    return StatusOK;
+}
+
+int BodySpill::status() const
+{
+    if (status_ == StatusOK && writes_ && writes_->failed())
+        return StatusFileWriteError;
+    return status_;
+}
+
+SubTask *BodySpill::create_barrier()
+{
+    if (!writes_)
+        return nullptr;
+
+    WFCounterTask *barrier = WFTaskFactory::create_counter_task(1, nullptr);
+    writes_->when_drained([barrier]() { barrier->count(); });
+    return barrier;
+}
+
+StringPiece BodySpill::view()
+{
+    if (this->status() != StatusOK)
+        return StringPiece();
+    if (!file_)
+        return StringPiece(data_);
+
+    if (!map_ && file_->size() > 0)
+    {
+        void *map = mmap(nullptr, file_->size(), PROT_READ, MAP_PRIVATE, file_->fd(), 0);
+        if (map == MAP_FAILED)
+        {
+            status_ = StatusFileReadError;
+            return StringPiece();
+        }
+        madvise(map, file_->size(), MADV_SEQUENTIAL);
+        map_ = map;
+        map_size_ = file_->size();
+    }
+    return StringPiece(static_cast<const char *>(map_), map_size_);
+}
+
+void BodySpill::release()
+{
+    if (map_)
+    {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+        map_size_ = 0;
+    }
+    file_.reset();
+    std::string().swap(data_);
+}
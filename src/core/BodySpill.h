@@ -0,0 +1,62 @@
+#ifndef WFREST_BODYSPILL_H_
+#define WFREST_BODYSPILL_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "BodyStream.h"
+#include "StringPiece.h"
+
+namespace wfrest
+{
+
+class SpoolFile;
+class SpoolWrites;
+
+// The whole body of a request, see RouteOptions::body_memory_limit.
+// Up to memory_limit bytes stay in memory, past that all of it goes to a
+// SpoolFile and view() is an mmap of the file once the writes are done.
+class BodySpill : public BodyConsumer, public Noncopyable
+{
+public:
+    // spilled_bytes : what went to the file is added there
+    BodySpill(size_t memory_limit, const std::string &spool_dir,
+              std::atomic<size_t> *spilled_bytes);
+
+    ~BodySpill();
+
+    int on_data(const char *data, size_t len) override;
+
+    int on_end() override;
+
+    int status() const override;
+
+    // waits for the spool writes
+    SubTask *create_barrier() override;
+
+    // Not before the barrier. Empty if status() is not StatusOK.
+    // Valid until release().
+    StringPiece view();
+
+    bool spilled() const
+    { return file_ != nullptr; }
+
+    // unmaps and removes the file
+    void release();
+
+private:
+    size_t memory_limit_;
+    std::string spool_dir_;
+    std::atomic<size_t> *spilled_bytes_;
+    int status_;
+
+    std::string data_;                      // the body, until it spills
+    std::shared_ptr<SpoolWrites> writes_;
+    std::shared_ptr<SpoolFile> file_;
+    void *map_;
+    size_t map_size_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_BODYSPILL_H_
@@ -0,0 +1,158 @@
+#include <errno.h>
+#include "BodyStream.h"
+#include "ErrorCode.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+inline int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+ssize_t ChunkedDecoder::feed(const char *data, size_t len, BodyConsumer *consumer)
+{
+    size_t i = 0;
+    while (i < len && state_ != DONE)
+    {
+        char c = data[i];
+        switch (state_)
+        {
+            case SIZE:
+            {
+                int digit = hex_digit(c);
+                if (digit >= 0)
+                {
+                    // 15 hex digits is well past anything size_t can take in
+                    if (++size_digits_ > 15)
+                        return -1;
+                    chunk_left_ = chunk_left_ * 16 + digit;
+                    break;
+                }
+                if (size_digits_ == 0)
+                    return -1;
+                if (c == ';' || c == ' ' || c == '\t')
+                    state_ = SIZE_EXT;
+                else if (c == '\r')
+                    state_ = SIZE_LF;
+                else if (c == '\n')
+                    state_ = chunk_left_ ? DATA : TRAILER;
+                else
+                    return -1;
+                break;
+            }
+            case SIZE_EXT:
+                if (c == '\r')
+                    state_ = SIZE_LF;
+                else if (c == '\n')
+                    state_ = chunk_left_ ? DATA : TRAILER;
+                break;
+            case SIZE_LF:
+                if (c != '\n')
+                    return -1;
+                state_ = chunk_left_ ? DATA : TRAILER;
+                break;
+            case DATA:
+            {
+                size_t n = len - i < chunk_left_ ? len - i : chunk_left_;
+                if (n > limit_ - body_size_)
+                {
+                    too_large_ = true;
+                    return -1;
+                }
+                body_size_ += n;
+                if (consumer->on_data(data + i, n) != StatusOK)
+                    return -1;
+                chunk_left_ -= n;
+                i += n;
+                if (chunk_left_ == 0)
+                    state_ = DATA_CR;
+                continue;
+            }
+            case DATA_CR:
+                if (c == '\r')
+                    state_ = DATA_LF;
+                else if (c == '\n')
+                    state_ = SIZE;
+                else
+                    return -1;
+                size_digits_ = 0;
+                break;
+            case DATA_LF:
+                if (c != '\n')
+                    return -1;
+                state_ = SIZE;
+                break;
+            case TRAILER:
+                if (c == '\r')
+                    state_ = TRAILER_LF;
+                else if (c == '\n')
+                    state_ = DONE;
+                else
+                    state_ = TRAILER_LINE;
+                break;
+            case TRAILER_LINE:
+                if (c == '\n')
+                    state_ = TRAILER;
+                break;
+            case TRAILER_LF:
+                if (c != '\n')
+                    return -1;
+                state_ = DONE;
+                break;
+            default:
+                break;
+        }
+        i++;
+    }
+    return i;
+}
+
+int BodyIntake::append(const char *data, size_t *size)
+{
+    size_t used;
+    bool done;
+    if (chunked_)
+    {
+        ssize_t n = decoder_.feed(data, *size, consumer_.get());
+        if (n < 0)
+        {
+            errno = decoder_.too_large() ? EMSGSIZE : EBADMSG;
+            return -1;
+        }
+        used = n;
+        done = decoder_.done();
+    }
+    else
+    {
+        used = *size < remaining_ ? *size : remaining_;
+        if (used > 0 && consumer_->on_data(data, used) != StatusOK)
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+        remaining_ -= used;
+        done = remaining_ == 0;
+    }
+
+    if (!done)
+        return 0;
+
+    if (consumer_->on_end() != StatusOK)
+    {
+        errno = EBADMSG;
+        return -1;
+    }
+    *size = used;
+    return 1;
+}
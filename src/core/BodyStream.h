@@ -0,0 +1,106 @@
+#ifndef WFREST_BODYSTREAM_H_
+#define WFREST_BODYSTREAM_H_
+
+#include <sys/types.h>
+#include <functional>
+#include <memory>
+#include "Noncopyable.h"
+
+class SubTask;
+
+namespace wfrest
+{
+
+// Takes the request body as it comes off the wire, already de-chunked,
+// instead of the http parser buffering all of it.
+// on_data() and on_end() run in the network thread.
+class BodyConsumer
+{
+public:
+    virtual ~BodyConsumer() {}
+
+    // anything but StatusOK drops the connection, prefer keeping the
+    // error for status() so the handler can still reply
+    virtual int on_data(const char *data, size_t len) = 0;
+
+    virtual int on_end() = 0;
+
+    // StatusOK or why the body is unusable
+    virtual int status() const = 0;
+
+    // Something the handler has to wait for, e.g. writes still in flight.
+    // Pushed in front of the handler, nullptr if there is nothing.
+    virtual SubTask *create_barrier()
+    { return nullptr; }
+
+    // The request goes before its handler ran, e.g. the client hung up.
+    // true if work in flight still uses it : release is called once that
+    // is over, and only then may the request go.
+    virtual bool release_later(std::function<void()> release)
+    { return false; }
+};
+
+// Transfer-Encoding: chunked, any number of bytes at a time
+class ChunkedDecoder
+{
+public:
+    // Bytes taken, which stops at the end of the body when done() turns
+    // true. -1 if the encoding is broken, the consumer failed or the body
+    // goes past the limit.
+    ssize_t feed(const char *data, size_t len, BodyConsumer *consumer);
+
+    bool done() const
+    { return state_ == DONE; }
+
+    // of the de-chunked body, nothing past it reaches the consumer
+    void set_limit(size_t limit)
+    { limit_ = limit; }
+
+    bool too_large() const
+    { return too_large_; }
+
+private:
+    enum State
+    {
+        SIZE, SIZE_EXT, SIZE_LF, DATA, DATA_CR, DATA_LF,
+        TRAILER, TRAILER_LINE, TRAILER_LF, DONE,
+    };
+
+    State state_ = SIZE;
+    size_t chunk_left_ = 0;
+    int size_digits_ = 0;
+    size_t limit_ = static_cast<size_t>(-1);
+    size_t body_size_ = 0;
+    bool too_large_ = false;
+};
+
+// The body of one request once it bypasses the parser, framed by
+// Content-Length or by chunks
+class BodyIntake : public Noncopyable
+{
+public:
+    // limit : of a chunked body, a Content-Length is checked before this
+    BodyIntake(BodyConsumer *consumer, bool chunked, size_t content_length, size_t limit)
+        : consumer_(consumer),
+          chunked_(chunked),
+          remaining_(content_length)
+    { decoder_.set_limit(limit); }
+
+    // Same contract as HttpMessage::append() : 1 once the body is complete,
+    // with *size the bytes used, 0 for more, -1 with errno set, EMSGSIZE
+    // if the body goes past the limit.
+    int append(const char *data, size_t *size);
+
+    BodyConsumer *consumer() const
+    { return consumer_.get(); }
+
+private:
+    std::unique_ptr<BodyConsumer> consumer_;
+    bool chunked_;
+    size_t remaining_;      // Content-Length left
+    ChunkedDecoder decoder_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_BODYSTREAM_H_
@@ -0,0 +1,108 @@
+#ifndef WFREST_HEADERINDEX_H_
+#define WFREST_HEADERINDEX_H_
+
+#include <strings.h>
+#include "StringPiece.h"
+#include "HttpDef.h"
+#include "Arena.h"
+
+namespace wfrest
+{
+
+// ASCII only, header names are tokens
+inline size_t header_name_hash(const StringPiece &name)
+{
+    size_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        unsigned char c = name.data()[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// name and value point into the parser of the request
+struct HeaderField
+{
+    StringPiece name;
+    StringPiece value;
+    size_t hash;        // header_name_hash(name)
+};
+
+// The request headers, in the order they came in.
+// The first k_inline_size live inside the object, so filling it
+// does not allocate for any ordinary request.
+// The first of each HTTP_KNOWN_HEADER_MAP header is also kept in a slot.
+class HeaderIndex
+{
+public:
+    static const size_t k_inline_size = 16;
+
+    HeaderIndex()
+    {}
+
+    // the ones past k_inline_size go to arena
+    explicit HeaderIndex(Arena *arena)
+        : overflow_(ArenaAllocator<HeaderField>(arena))
+    {}
+
+    void add(const StringPiece &name, const StringPiece &value)
+    {
+        HeaderField field{name, value, header_name_hash(name)};
+        if (size_ < k_inline_size)
+            inline_[size_] = field;
+        else
+            overflow_.push_back(field);
+        size_++;
+
+        enum http_header_id id = KnownHeader::to_enum(name);
+        if (id != HEADER_UNKNOWN && known_[id] == 0)
+            known_[id] = size_;
+    }
+
+    const HeaderField *find(enum http_header_id id) const
+    { return known_[id] ? &(*this)[known_[id] - 1] : nullptr; }
+
+    // case insensitive, the first one wins if a header appears twice
+    const HeaderField *find(const StringPiece &name) const
+    {
+        size_t hash = header_name_hash(name);
+        for (size_t i = 0; i < size_; i++)
+        {
+            const HeaderField &field = (*this)[i];
+            if (field.hash == hash && field.name.size() == name.size() &&
+                strncasecmp(field.name.data(), name.data(), name.size()) == 0)
+                return &field;
+        }
+        return nullptr;
+    }
+
+    const HeaderField &operator[](size_t i) const
+    { return i < k_inline_size ? inline_[i] : overflow_[i - k_inline_size]; }
+
+    size_t size() const
+    { return size_; }
+
+    bool empty() const
+    { return size_ == 0; }
+
+    void clear()
+    {
+        size_ = 0;
+        overflow_.clear();
+        for (size_t &slot : known_)
+            slot = 0;
+    }
+
+private:
+    HeaderField inline_[k_inline_size];
+    size_t size_ = 0;
+    size_t known_[HEADER_UNKNOWN] = {};     // index + 1, 0 if missing
+    ArenaVector<HeaderField> overflow_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_HEADERINDEX_H_
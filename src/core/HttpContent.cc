@@ -9,6 +9,9 @@
 #include "StringPiece.h"
 #include "PathUtil.h"
 #include "HttpDef.h"
+#include "SpoolFile.h"
+#include "ErrorCode.h"
+#include "KvUtil.h"
 
 using namespace wfrest;
 
@@ -17,45 +20,141 @@ const std::string MultiPartForm::k_default_boundary = "----WebKitFormBoundary7MA
 // 对请求体的数据进行切分
 std::map<std::string, std::string> Urlencode::parse_post_kv(const StringPiece &body)
 {
-    std::map<std::string, std::string> map;
-
-    if (body.empty())
-        return map;
-
-    // 对请求表单中的数据按 '&' 进行切分
-    std::vector<StringPiece> arr = StrUtil::split_piece<StringPiece>(body, '&');
+    return KvUtil::split_to_map(body, KvSyntax::URLENCODED);
+}
 
-    if (arr.empty())
-        return map;
+namespace
+{
 
-    for (const auto &ele: arr)
+// Content-Disposition: attachment
+// Content-Disposition: attachment; filename="filename.jpg"
+// Content-Disposition: form-data; name="avatar"; filename="user.jpg"
+// name and filename are views into header_value
+void parse_content_disposition(const StringPiece &header_value,
+                               OUT StringPiece &name, OUT StringPiece &filename)
+{
+    // 对 数据的描述字段的值进行切分
+    const char *pos = header_value.data();
+    const char *end = pos + header_value.size();
+    while (pos < end)
     {
-        if (ele.empty())
+        const char *semi = static_cast<const char *>(memchr(pos, ';', end - pos));
+        if (!semi)
+            semi = end;
+        StringPiece dispo = StrUtil::trim(StringPiece(pos, semi - pos));
+        pos = semi + 1;
+
+        // name="file"
+        // key is name, value is "file"
+        const char *eq = static_cast<const char *>(memchr(dispo.data(), '=', dispo.size()));
+        if (!eq || memchr(eq + 1, '=', dispo.data() + dispo.size() - eq - 1))
             continue;
+        StringPiece key(dispo.data(), eq - dispo.data());
+        StringPiece value = StrUtil::trim_pairs(
+                StringPiece(eq + 1, dispo.data() + dispo.size() - eq - 1), R"(""'')");
+        if (key.starts_with(StringPiece("name")))
+        {
+            name = value;
+        } else if (key.starts_with(StringPiece("filename")))
+        {
+            filename = value;
+        }
+    }
+}
 
-        // 对数据 按 '=' 进行切分，划分出数据的 键和值
-        std::vector<std::string> kv = StrUtil::split_piece<std::string>(ele, '=');
-        size_t kv_size = kv.size();
-        std::string &key = kv[0];
+void parse_content_disposition(const StringPiece &header_value,
+                               OUT std::string &name, OUT std::string &filename)
+{
+    StringPiece name_view;
+    StringPiece filename_view;
+    parse_content_disposition(header_value, name_view, filename_view);
+    if (name_view.data())
+        name = name_view.as_string();
+    if (filename_view.data())
+        filename = filename_view.as_string();
+}
 
-        if (key.empty() || map.count(key) > 0)
-            continue;
+// FormView::parse() state, the body is all there
+struct FormViewParse
+{
+    const char *body_begin;
+    const char *body_end;
+    ArenaVector<FormView::Part> *parts;
+    ArenaVector<HeaderField> *headers;
+    StringPiece header_field;
+    bool in_data;
+    bool ended;
+
+    static FormViewParse *of(multipart_parser *parser)
+    { return static_cast<FormViewParse *>(multipart_parser_get_data(parser)); }
+
+    static int header_field_cb(multipart_parser *parser, const char *buf, size_t len)
+    {
+        of(parser)->header_field = StringPiece(buf, len);
+        return 0;
+    }
 
-        if (kv_size == 1)
+    static int header_value_cb(multipart_parser *parser, const char *buf, size_t len)
+    {
+        FormViewParse *ctx = of(parser);
+        if (ctx->parts->empty())
+            return 1;
+        FormView::Part &part = ctx->parts->back();
+        StringPiece value(buf, len);
+        ctx->headers->push_back({ctx->header_field, value, header_name_hash(ctx->header_field)});
+        if (ctx->header_field.size() == 19 &&
+            strncasecmp(ctx->header_field.data(), "Content-Disposition", 19) == 0)
+            parse_content_disposition(value, part.name, part.filename);
+        else if (ctx->header_field.size() == 12 &&
+                 strncasecmp(ctx->header_field.data(), "Content-Type", 12) == 0)
+            part.content_type = value;
+        return 0;
+    }
+
+    // Data the parser held back in its lookbehind comes from elsewhere,
+    // but it is always the body bytes right after what came so far.
+    static int part_data_cb(multipart_parser *parser, const char *buf, size_t len)
+    {
+        FormViewParse *ctx = of(parser);
+        if (ctx->parts->empty())
+            return 1;
+        FormView::Part &part = ctx->parts->back();
+        if (!ctx->in_data)
         {
-            map.emplace(std::move(key), "");
-            continue;
+            if (buf < ctx->body_begin || buf > ctx->body_end)
+                return 1;
+            part.data = StringPiece(buf, static_cast<size_t>(0));
+            ctx->in_data = true;
         }
+        part.data = StringPiece(part.data.data(), part.data.size() + len);
+        return 0;
+    }
+
+    static int part_data_begin_cb(multipart_parser *parser)
+    {
+        FormViewParse *ctx = of(parser);
+        ctx->parts->emplace_back();
+        ctx->parts->back().header_begin = ctx->headers->size();
+        ctx->in_data = false;
+        return 0;
+    }
 
-        std::string &val = kv[1];
+    static int headers_complete_cb(multipart_parser *parser)
+    {
+        FormViewParse *ctx = of(parser);
+        if (!ctx->parts->empty())
+            ctx->parts->back().header_end = ctx->headers->size();
+        return 0;
+    }
 
-        if (val.empty())
-            map.emplace(std::move(key), "");
-        else
-            map.emplace(std::move(key), std::move(val));
+    static int body_end_cb(multipart_parser *parser)
+    {
+        of(parser)->ended = true;
+        return 0;
     }
-    return map;
-}
+};
+
+}  // namespace
 
 // multipart 解析器的状态
 enum multipart_parser_state_e
@@ -92,31 +191,7 @@ void multipart_parser_userdata::handle_header()
     if (header_field.empty() || header_value.empty()) return;
     if (strcasecmp(header_field.c_str(), "Content-Disposition") == 0)
     {
-        // Content-Disposition: attachment
-        // Content-Disposition: attachment; filename="filename.jpg"
-        // Content-Disposition: form-data; name="avatar"; filename="user.jpg"
-        // 对 数据的描述字段的值进行切分    
-        StringPiece header_val_piece(header_value);
-        std::vector<StringPiece> dispo_list = StrUtil::split_piece<StringPiece>(header_val_piece, ';');
-
-        for (auto &dispo: dispo_list)
-        {
-            auto kv = StrUtil::split_piece<StringPiece>(StrUtil::trim(dispo), '=');
-            if (kv.size() == 2)
-            {
-                // name="file"
-                // kv[0] is key(name)
-                // kv[1] is value("file")
-                StringPiece value = StrUtil::trim_pairs(kv[1], R"(""'')");
-                if (kv[0].starts_with(StringPiece("name")))
-                {
-                    name = value.as_string();
-                } else if (kv[0].starts_with(StringPiece("filename")))
-                {
-                    filename = value.as_string();
-                }
-            }
-        }
+        parse_content_disposition(StringPiece(header_value), name, filename);
     }
     header_field.clear();
     header_value.clear();
@@ -224,6 +299,242 @@ Form MultiPartForm::parse_multipart(const StringPiece &body) const
 }
 
 
+bool FormView::parse(const StringPiece &body, const std::string &boundary)
+{
+    parts_.clear();
+    headers_.clear();
+
+    multipart_parser_settings settings = {
+            .on_header_field = FormViewParse::header_field_cb,
+            .on_header_value = FormViewParse::header_value_cb,
+            .on_part_data = FormViewParse::part_data_cb,
+            .on_part_data_begin = FormViewParse::part_data_begin_cb,
+            .on_headers_complete = FormViewParse::headers_complete_cb,
+            .on_part_data_end = nullptr,
+            .on_body_end = FormViewParse::body_end_cb
+    };
+    FormViewParse ctx;
+    ctx.body_begin = body.data();
+    ctx.body_end = body.data() + body.size();
+    ctx.parts = &parts_;
+    ctx.headers = &headers_;
+    ctx.in_data = false;
+    ctx.ended = false;
+
+    std::string dash_boundary = "--" + boundary;
+    multipart_parser *parser = multipart_parser_init(dash_boundary.c_str(), &settings);
+    multipart_parser_set_data(parser, &ctx);
+    size_t num_parse = multipart_parser_execute(parser, body.data(), body.size());
+    multipart_parser_free(parser);
+
+    if (num_parse != body.size() || !ctx.ended)
+    {
+        parts_.clear();
+        headers_.clear();
+        return false;
+    }
+    return true;
+}
+
+const FormView::Part *FormView::find(const StringPiece &name) const
+{
+    for (const Part &part : parts_)
+    {
+        if (part.name == name)
+            return &part;
+    }
+    return nullptr;
+}
+
+std::vector<const FormView::Part *> FormView::find_all(const StringPiece &name) const
+{
+    std::vector<const Part *> found;
+    for (const Part &part : parts_)
+    {
+        if (part.name == name)
+            found.push_back(&part);
+    }
+    return found;
+}
+
+StringPiece FormView::header(const Part &part, const StringPiece &name) const
+{
+    size_t hash = header_name_hash(name);
+    for (size_t i = part.header_begin; i < part.header_end; i++)
+    {
+        const HeaderField &field = headers_[i];
+        if (field.hash == hash && field.name.size() == name.size() &&
+            strncasecmp(field.name.data(), name.data(), name.size()) == 0)
+            return field.value;
+    }
+    return StringPiece();
+}
+
+MultiPartStream::MultiPartStream(const std::string &boundary, size_t memory_limit,
+                                 const std::string &spool_dir)
+    : memory_limit_(memory_limit),
+      spool_dir_(spool_dir),
+      ended_(false),
+      status_(StatusOK)
+{
+    settings_ = {
+            .on_header_field = header_field_cb,
+            .on_header_value = header_value_cb,
+            .on_part_data = part_data_cb,
+            .on_part_data_begin = part_data_begin_cb,
+            .on_headers_complete = headers_complete_cb,
+            .on_part_data_end = part_data_end_cb,
+            .on_body_end = body_end_cb
+    };
+    std::string dash_boundary = "--" + boundary;
+    parser_ = multipart_parser_init(dash_boundary.c_str(), &settings_);
+    multipart_parser_set_data(parser_, this);
+}
+
+MultiPartStream::~MultiPartStream()
+{
+    multipart_parser_free(parser_);
+}
+
+// a broken body is kept for status(), the rest of it is read and dropped
+int MultiPartStream::on_data(const char *data, size_t len)
+{
+    if (status_ != StatusOK || ended_)
+        return StatusOK;
+
+    size_t num_parse = multipart_parser_execute(parser_, data, len);
+    if (num_parse != len && status_ == StatusOK)
+        status_ = StatusFormInvalid;
+    return StatusOK;
+}
+
+int MultiPartStream::on_end()
+{
+    if (status_ == StatusOK && !ended_)
+        status_ = StatusFormInvalid;
+    return StatusOK;
+}
+
+int MultiPartStream::status() const
+{
+    if (status_ == StatusOK && writes_ && writes_->failed())
+        return StatusFileWriteError;
+    return status_;
+}
+
+SubTask *MultiPartStream::create_barrier()
+{
+    if (!writes_)
+        return nullptr;
+
+    WFCounterTask *barrier = WFTaskFactory::create_counter_task(1, nullptr);
+    writes_->when_drained([barrier]() { barrier->count(); });
+    return barrier;
+}
+
+void MultiPartStream::handle_header()
+{
+    if (header_field_.empty() || header_value_.empty() || parts_.empty())
+        return;
+
+    FormPart &part = parts_.back();
+    if (strcasecmp(header_field_.c_str(), "Content-Disposition") == 0)
+        parse_content_disposition(StringPiece(header_value_), part.name, part.filename);
+    else if (strcasecmp(header_field_.c_str(), "Content-Type") == 0)
+        part.content_type = header_value_;
+
+    header_field_.clear();
+    header_value_.clear();
+}
+
+int MultiPartStream::handle_data(const char *buf, size_t len)
+{
+    if (parts_.empty())
+        return 0;
+
+    FormPart &part = parts_.back();
+    part.size += len;
+    if (file_)
+    {
+        file_->write(buf, len);
+        return 0;
+    }
+    if (part.data.size() + len <= memory_limit_)
+    {
+        part.data.append(buf, len);
+        return 0;
+    }
+
+    if (!writes_)
+        writes_ = std::make_shared<SpoolWrites>();
+    file_ = SpoolFile::create(spool_dir_, writes_);
+    if (!file_)
+    {
+        status_ = StatusFileWriteError;
+        return -1;
+    }
+    files_.push_back(file_);
+    part.path = file_->path();
+    file_->write(part.data.data(), part.data.size());
+    file_->write(buf, len);
+    std::string().swap(part.data);
+    return 0;
+}
+
+int MultiPartStream::header_field_cb(multipart_parser *parser, const char *buf, size_t len)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    stream->handle_header();
+    stream->header_field_.append(buf, len);
+    return 0;
+}
+
+int MultiPartStream::header_value_cb(multipart_parser *parser, const char *buf, size_t len)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    stream->header_value_.append(buf, len);
+    return 0;
+}
+
+int MultiPartStream::part_data_cb(multipart_parser *parser, const char *buf, size_t len)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    return stream->handle_data(buf, len);
+}
+
+int MultiPartStream::part_data_begin_cb(multipart_parser *parser)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    stream->parts_.emplace_back();
+    stream->header_field_.clear();
+    stream->header_value_.clear();
+    return 0;
+}
+
+int MultiPartStream::headers_complete_cb(multipart_parser *parser)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    stream->handle_header();
+    return 0;
+}
+
+int MultiPartStream::part_data_end_cb(multipart_parser *parser)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    if (stream->file_)
+    {
+        stream->file_->flush();
+        stream->file_.reset();
+    }
+    return 0;
+}
+
+int MultiPartStream::body_end_cb(multipart_parser *parser)
+{
+    auto *stream = static_cast<MultiPartStream *>(multipart_parser_get_data(parser));
+    stream->ended_ = true;
+    return 0;
+}
 
 MultiPartEncoder::MultiPartEncoder()
     : boundary_(MultiPartForm::k_default_boundary)
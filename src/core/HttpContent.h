@@ -3,16 +3,17 @@
 
 #include <string>
 #include <map>
+#include <memory>
 #include <vector>
 #include "MultiPartParser.h"
 #include "Macro.h"
 #include "Noncopyable.h"
+#include "BodyStream.h"
+#include "HeaderIndex.h"
 
 namespace wfrest
 {
 
-class StringPiece;
-
 // Urlencode 格式数据
 class Urlencode
 {
@@ -40,6 +41,9 @@ public:
     void set_boundary(const std::string &boundary)
     { boundary_ = boundary; }
 
+    const std::string &boundary() const
+    { return boundary_; }
+
 public:
     static const std::string k_default_boundary;
 
@@ -65,6 +69,145 @@ private:
     multipart_parser_settings settings_;
 };
 
+// A multipart body parsed in place, every view points into the body.
+// Fields that appear twice are kept twice, in order.
+class FormView
+{
+public:
+    struct Part
+    {
+        StringPiece name;
+        StringPiece filename;
+        StringPiece content_type;
+        StringPiece data;
+        size_t header_begin = 0;    // [header_begin, header_end) in headers()
+        size_t header_end = 0;
+    };
+
+    using const_iterator = ArenaVector<Part>::const_iterator;
+
+    FormView()
+    {}
+
+    // parts and headers go to arena
+    explicit FormView(Arena *arena)
+        : parts_(ArenaAllocator<Part>(arena)),
+          headers_(ArenaAllocator<HeaderField>(arena))
+    {}
+
+    // false and empty if the body is not well formed
+    bool parse(const StringPiece &body, const std::string &boundary);
+
+    // the first part called name, nullptr if none
+    const Part *find(const StringPiece &name) const;
+
+    // every part called name
+    std::vector<const Part *> find_all(const StringPiece &name) const;
+
+    // a header of the part itself, case insensitive, empty if missing
+    StringPiece header(const Part &part, const StringPiece &name) const;
+
+    const ArenaVector<HeaderField> &headers() const
+    { return headers_; }
+
+    const Part &operator[](size_t i) const
+    { return parts_[i]; }
+
+    size_t size() const
+    { return parts_.size(); }
+
+    bool empty() const
+    { return parts_.empty(); }
+
+    const_iterator begin() const
+    { return parts_.begin(); }
+
+    const_iterator end() const
+    { return parts_.end(); }
+
+private:
+    ArenaVector<Part> parts_;
+    ArenaVector<HeaderField> headers_;
+};
+
+// One part of a streamed multipart body
+struct FormPart
+{
+    std::string name;
+    std::string filename;
+    std::string content_type;
+    size_t size = 0;
+    std::string path;       // temp file if spooled, removed with the request
+    std::string data;       // the content if it was not spooled
+
+    bool spooled() const
+    { return !path.empty(); }
+};
+
+using FormParts = std::vector<FormPart>;
+
+class SpoolFile;
+class SpoolWrites;
+
+// Feeds multipart_parser_execute as the body comes in.
+// A part stays in memory up to memory_limit bytes, past that it goes
+// to a temp file in spool_dir through async pwrite tasks.
+class MultiPartStream : public BodyConsumer, public Noncopyable
+{
+public:
+    MultiPartStream(const std::string &boundary, size_t memory_limit,
+                    const std::string &spool_dir);
+
+    ~MultiPartStream();
+
+    int on_data(const char *data, size_t len) override;
+
+    int on_end() override;
+
+    int status() const override;
+
+    // waits for the spool writes
+    SubTask *create_barrier() override;
+
+    const FormParts &parts() const
+    { return parts_; }
+
+private:
+    static int header_field_cb(multipart_parser *parser, const char *buf, size_t len);
+
+    static int header_value_cb(multipart_parser *parser, const char *buf, size_t len);
+
+    static int part_data_cb(multipart_parser *parser, const char *buf, size_t len);
+
+    static int part_data_begin_cb(multipart_parser *parser);
+
+    static int headers_complete_cb(multipart_parser *parser);
+
+    static int part_data_end_cb(multipart_parser *parser);
+
+    static int body_end_cb(multipart_parser *parser);
+
+    void handle_header();
+
+    int handle_data(const char *buf, size_t len);
+
+private:
+    multipart_parser *parser_;
+    multipart_parser_settings settings_;
+    size_t memory_limit_;
+    std::string spool_dir_;
+
+    std::string header_field_;
+    std::string header_value_;
+    FormParts parts_;
+    bool ended_;
+    int status_;
+
+    std::shared_ptr<SpoolFile> file_;                   // of the part being read
+    std::vector<std::shared_ptr<SpoolFile>> files_;     // live as long as the request
+    std::shared_ptr<SpoolWrites> writes_;
+};
+
 class MultiPartEncoder 
 {
 public:
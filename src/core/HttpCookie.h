@@ -43,6 +43,9 @@ public:
 
     std::string dump() const;
 
+    // the Set-Cookie value, appended to out
+    void dump(std::string &out) const;
+
     static std::map<std::string, std::string> split(const StringPiece &cookie_piece);   // 将 cookie 切分成 键值对的形式
 
 public:
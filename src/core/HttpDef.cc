@@ -1,24 +1,9 @@
 #include "HttpDef.h"
 #include <cstring>
+#include <strings.h>
 
 using namespace wfrest;
 
-namespace 
-{
-
-int strstartswith(const char *str, const char *start)
-{
-    while (*str && *start && *str == *start)
-    {
-        ++str;
-        ++start;
-    }
-    return *start == '\0';
-}
-
-} // namespace 
-
-
 std::string ContentType::to_str(enum http_content_type type)
 {
     switch (type)
@@ -31,14 +16,14 @@ std::string ContentType::to_str(enum http_content_type type)
     }
 }
 
-enum http_content_type ContentType::to_enum(const std::string &content_type_str)
+enum http_content_type ContentType::to_enum(const StringPiece &content_type_str)
 {
     if (content_type_str.empty())
     {
         return CONTENT_TYPE_NONE;
     }
 #define XX(name, string, suffix) \
-    if (strstartswith(content_type_str.c_str(), #string)) { \
+    if (content_type_str.starts_with(#string)) { \
         return name; \
     }
     HTTP_CONTENT_TYPE_MAP(XX)
@@ -74,3 +59,27 @@ enum http_content_type ContentType::to_enum_by_suffix(const std::string &str)
 #undef XX
     return CONTENT_TYPE_UNDEFINED;
 }
+
+const char *KnownHeader::to_str(enum http_header_id id)
+{
+    switch (id)
+    {
+#define XX(name, header) case name: return #header;
+        HTTP_KNOWN_HEADER_MAP(XX)
+#undef XX
+        default:
+            return "<unknown>";
+    }
+}
+
+enum http_header_id KnownHeader::to_enum(const StringPiece &name)
+{
+#define XX(name_id, header) \
+    if (name.size() == sizeof(#header) - 1 && \
+        strncasecmp(name.data(), #header, name.size()) == 0) { \
+        return name_id; \
+    }
+    HTTP_KNOWN_HEADER_MAP(XX)
+#undef XX
+    return HEADER_UNKNOWN;
+}
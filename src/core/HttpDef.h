@@ -2,6 +2,7 @@
 #define WFREST_HTTPDEF_H_
 
 #include <string>
+#include "StringPiece.h"
 
 namespace wfrest
 {
@@ -44,11 +45,40 @@ public:
 
     static std::string to_str_by_suffix(const std::string &suffix);
 
-    static enum http_content_type to_enum(const std::string &content_type_str);
+    static enum http_content_type to_enum(const StringPiece &content_type_str);
 
     static enum http_content_type to_enum_by_suffix(const std::string &suffix);
 };
 
+// Headers looked up on every request, they get a slot on HttpReq and HttpResp
+// XX(name, header)
+#define HTTP_KNOWN_HEADER_MAP(XX) \
+    XX(HEADER_HOST,             Host)                   \
+    XX(HEADER_CONTENT_TYPE,     Content-Type)           \
+    XX(HEADER_CONTENT_LENGTH,   Content-Length)         \
+    XX(HEADER_CONTENT_ENCODING, Content-Encoding)       \
+    XX(HEADER_COOKIE,           Cookie)                 \
+    XX(HEADER_CONNECTION,       Connection)             \
+    XX(HEADER_KEEP_ALIVE,       Keep-Alive)             \
+    XX(HEADER_DATE,             Date)                   \
+
+enum http_header_id
+{
+#define XX(name, header)   name,
+    HTTP_KNOWN_HEADER_MAP(XX)
+    HEADER_UNKNOWN
+#undef XX
+};
+
+class KnownHeader
+{
+public:
+    static const char *to_str(enum http_header_id id);
+
+    // case insensitive, HEADER_UNKNOWN for any other header
+    static enum http_header_id to_enum(const StringPiece &name);
+};
+
 } // wfrest
 
 #endif // WFREST_HTTPDEF_H_
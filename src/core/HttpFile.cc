@@ -92,7 +92,7 @@ int HttpFile::send_file(const std::string &path, size_t file_start, size_t file_
     if (content_type == CONTENT_TYPE_NONE || content_type == CONTENT_TYPE_UNDEFINED) {
         content_type = APPLICATION_OCTET_STREAM;
     }
-    resp->headers["Content-Type"] = ContentType::to_str(content_type);
+    resp->set_known_header(HEADER_CONTENT_TYPE, ContentType::to_str(content_type));
 
     size_t size = end - start;
     void *buf = malloc(size);
@@ -104,9 +104,9 @@ int HttpFile::send_file(const std::string &path, size_t file_start, size_t file_
                               });
     // https://datatracker.ietf.org/doc/html/rfc7233#section-4.2
     // Content-Range: bytes 42-1233/1234
-    resp->headers["Content-Range"] = "bytes " + std::to_string(start)
-                                            + "-" + std::to_string(end)
-                                            + "/" + std::to_string(size);
+    resp->header_fields().set("Content-Range", "bytes " + std::to_string(start)
+                                               + "-" + std::to_string(end)
+                                               + "/" + std::to_string(size));
 
     WFFileIOTask *pread_task = WFTaskFactory::create_pread_task(path,
                                                                 buf,
@@ -3,6 +3,9 @@
 #include "workflow/WFMySQLConnection.h"
 #include "workflow/Workflow.h"
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <algorithm>
 
@@ -15,6 +18,10 @@
 #include "ErrorCode.h"
 #include "FileUtil.h"
 #include "HttpServerTask.h"
+#include "Router.h"
+#include "VerbHandler.h"
+#include "BodyPipe.h"
+#include "BodySpill.h"
 
 using namespace wfrest;
 using namespace protocol;
@@ -27,9 +34,26 @@ namespace wfrest
 struct ReqData
 {
     std::string body;   // 请求体中的数据
+    bool body_decoded = false;
+    bool body_in_spill = false;     // spilled and not compressed, body stays empty
+    int body_status = StatusOK;
     std::map<std::string, std::string> form_kv; // 表单——键值对 格式数据
+    bool form_list_parsed = false;
+    KeyValues form_list;
+    bool cookie_list_parsed = false;
+    KeyValues cookie_list;
     Form form;  // 表单数据
+    bool form_view_parsed = false;
+    FormView form_view;
     Json json;  // json 数据
+    bool json_parsed = false;
+    JsonError json_error;
+
+    explicit ReqData(Arena *arena)
+        : form_list(ArenaAllocator<KeyValue>(arena)),
+          cookie_list(ArenaAllocator<KeyValue>(arena)),
+          form_view(arena)
+    {}
 };
 
 struct ProxyCtx
@@ -293,38 +317,129 @@ void mysql_callback(WFMySQLTask *mysql_task)
 } // namespace wfrest
 
 // http请求
-HttpReq::HttpReq() : req_data_(new ReqData)
-{}
+HttpReq::HttpReq() : arena_(Arena::create()), route_full_path_(nullptr),
+    route_params_(arena_.get()), route_snapshot_(nullptr), route_options_(nullptr),
+    route_verb_handler_(nullptr), route_status_(-1),
+    query_parsed_(false), query_params_(ArenaAllocator<KeyValue>(arena_.get())),
+    headers_(arena_.get()), header_hook_(nullptr), headers_in_(false), header_end_(0),
+    header_size_(0), body_limit_(0), form_stream_(nullptr), body_spill_(nullptr)
+{
+    void *p = arena_->allocate(sizeof(ReqData), alignof(ReqData));
+    req_data_ = new (p) ReqData(arena_.get());
+}
+
+HttpReq::HttpReq(HttpRequest &&base_req) : HttpRequest(std::move(base_req)),
+    arena_(Arena::create()), route_full_path_(nullptr),
+    route_params_(arena_.get()), route_snapshot_(nullptr), route_options_(nullptr),
+    route_verb_handler_(nullptr), route_status_(-1),
+    query_parsed_(false), query_params_(ArenaAllocator<KeyValue>(arena_.get())),
+    headers_(arena_.get()), header_hook_(nullptr), headers_in_(false), header_end_(0),
+    header_size_(0), body_limit_(0), form_stream_(nullptr), body_spill_(nullptr)
+{
+    void *p = arena_->allocate(sizeof(ReqData), alignof(ReqData));
+    req_data_ = new (p) ReqData(arena_.get());
+}
 
 HttpReq::~HttpReq()
 {
-    delete req_data_;
+    // in arena_, which goes once all the members are gone
+    if (req_data_)
+        req_data_->~ReqData();
+    if (route_snapshot_)
+        route_snapshot_->unref();
+}
+
+void HttpReq::set_route_snapshot(const RouteSnapshot *snapshot)
+{
+    if (route_snapshot_)
+        route_snapshot_->unref();
+    route_snapshot_ = snapshot;
 }
 
 // 获取 请求体中的数据
 std::string &HttpReq::body() const
 {
-    if (req_data_->body.empty())
+    this->decode_body();
+    // copying the temp file back to the heap is what body_memory_limit is
+    // there to avoid, body_view() maps it
+    if (req_data_->body_in_spill && req_data_->body_status == StatusOK)
+        req_data_->body_status = StatusBodySpilled;
+    return req_data_->body;
+}
+
+void HttpReq::decode_body() const
+{
+    if (req_data_->body_decoded)
+        return;
+
+    req_data_->body_decoded = true;
+    StringPiece header = this->header(HEADER_CONTENT_ENCODING);
+    Compress method;
+    // 判断请求数据是否压缩；如果压缩了，先解压
+    bool compressed = !header.empty() && str_to_compress_method(header.data(), header.size(), method);
+    if (!header.empty() && !compressed)
+        req_data_->body_status = StatusNoUncomrpess;
+    if (body_spill_ && !compressed)
     {
-        std::string content = protocol::HttpUtil::decode_chunked_body(this);
+        req_data_->body_in_spill = true;
+        return;
+    }
 
-        const std::string &header = this->header("Content-Encoding");
-        int status = StatusOK;
-        // 判断请求数据是否压缩；如果压缩了，先解压
-        if (header.find("gzip") != std::string::npos)
-        {
-            status = Compressor::ungzip(&content, &req_data_->body);
-        }
-        else
-        {
-            status = StatusNoUncomrpess;
-        }
-        if(status != StatusOK)
+    std::string content;
+    StringPiece raw;
+    if (body_spill_)
+    {
+        raw = body_spill_->view();
+    } else
+    {
+        content = protocol::HttpUtil::decode_chunked_body(this);
+        raw = StringPiece(content);
+    }
+
+    if (!compressed)
+    {
+        req_data_->body = std::move(content);
+    } else
+    {
+        size_t max_size = RouteOptions::k_default_max_decoded_body;
+        if (route_options_)
+            max_size = route_options_->max_decoded_body;
+        req_data_->body_status = Compressor::inflate(method, raw.data(), raw.size(),
+                                                     max_size, &req_data_->body);
+    }
+}
+
+StringPiece HttpReq::body_view() const
+{
+    if (!req_data_->body_decoded && !body_spill_ && !this->is_chunked())
+    {
+        StringPiece header = this->header(HEADER_CONTENT_ENCODING);
+        Compress method;
+        if (header.empty() || !str_to_compress_method(header.data(), header.size(), method))
         {
-            req_data_->body = std::move(content);
+            const void *body;
+            size_t len;
+            if (this->get_parsed_body(&body, &len))
+                return StringPiece(static_cast<const char *>(body), len);
+            return StringPiece();
         }
     }
-    return req_data_->body;
+    this->decode_body();
+    if (req_data_->body_in_spill)
+        return body_spill_->view();
+    return StringPiece(req_data_->body);
+}
+
+int HttpReq::body_status() const
+{
+    if (body_intake_)
+    {
+        int status = body_intake_->consumer()->status();
+        if (!body_spill_ || status != StatusOK)
+            return status;
+    }
+    this->decode_body();
+    return req_data_->body_status;
 }
 
 // 获取表单的 键值
@@ -332,101 +447,334 @@ std::map<std::string, std::string> &HttpReq::form_kv() const
 {
     if (content_type_ == APPLICATION_URLENCODED && req_data_->form_kv.empty())
     {
-        StringPiece body_piece(this->body());
-        req_data_->form_kv = Urlencode::parse_post_kv(body_piece);  // 对请求的表单进行解析
+        // 对请求的表单进行解析，重复的键取第一个
+        for (const KeyValue &kv : this->form_list())
+            req_data_->form_kv.emplace(kv.key.as_string(), kv.value.as_string());
     }
     return req_data_->form_kv;
 }
 
+const KeyValues &HttpReq::form_list() const
+{
+    if (content_type_ == APPLICATION_URLENCODED && !req_data_->form_list_parsed)
+    {
+        req_data_->form_list_parsed = true;
+        KvUtil::split(this->body_view(), KvSyntax::URLENCODED,
+                      req_data_->form_list, arena_.get());
+    }
+    return req_data_->form_list;
+}
+
+const FormParts &HttpReq::form_parts() const
+{
+    static const FormParts no_parts;
+    return form_stream_ ? form_stream_->parts() : no_parts;
+}
+
+void HttpReq::stream_form(MultiPartStream *stream)
+{
+    set_body_consumer(stream);
+    form_stream_ = stream;
+}
+
+void HttpReq::stream_body(BodyPipe *pipe)
+{
+    set_body_consumer(pipe);
+}
+
+void HttpReq::spill_body(BodySpill *spill)
+{
+    set_body_consumer(spill);
+    body_spill_ = spill;
+}
+
+bool HttpReq::body_spilled() const
+{
+    return body_spill_ && body_spill_->spilled();
+}
+
+void HttpReq::release_spilled_body()
+{
+    if (body_spill_)
+        body_spill_->release();
+}
+
+void HttpReq::set_body_consumer(BodyConsumer *consumer)
+{
+    bool chunked = this->is_chunked();
+    size_t content_length = 0;
+    if (!chunked)
+        NumUtil::parse(StrUtil::trim(this->header(HEADER_CONTENT_LENGTH)), content_length);
+    size_t limit = body_limit_ ? body_limit_ : this->get_size_limit();
+    body_intake_.reset(new BodyIntake(consumer, chunked, content_length, limit));
+}
+
+SubTask *HttpReq::body_barrier() const
+{
+    return body_intake_ ? body_intake_->consumer()->create_barrier() : nullptr;
+}
+
+bool HttpReq::release_later(std::function<void()> release)
+{
+    return body_intake_ && body_intake_->consumer()->release_later(std::move(release));
+}
+
+size_t HttpReq::scan_header_end(const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        if (header_end_ == 0)
+        {
+            const void *lf = memchr(data + i, '\n', len - i);
+            if (!lf)
+                return len;
+            i = static_cast<const char *>(lf) - data;
+        }
+
+        char c = data[i++];
+        if (c == '\n')
+        {
+            if (header_end_ != 0)
+            {
+                headers_in_ = true;
+                return i;
+            }
+            header_end_ = 1;    // \n
+        }
+        else if (c == '\r' && header_end_ == 1)
+            header_end_ = 2;    // \n\r
+        else
+            header_end_ = 0;
+    }
+    return len;
+}
+
+// With a header hook the parser gets the headers alone, so that
+// on_headers() can still send the body somewhere else.
+int HttpReq::append(const void *buf, size_t *size)
+{
+    int ret;
+    if (body_intake_)
+        ret = body_intake_->append(static_cast<const char *>(buf), size);
+    else if (!header_hook_ || headers_in_)
+        ret = this->HttpRequest::append(buf, size);
+    else
+        return this->append_headers(static_cast<const char *>(buf), size);
+
+    if (ret < 0 && errno == EMSGSIZE && header_hook_)
+        this->reply_too_large();
+    return ret;
+}
+
+// The last \n of the headers is held back from the parser until the hook
+// is done : by then the parser has every header line, but it only answers
+// Expect: 100-continue once it sees them complete.
+int HttpReq::append_headers(const char *data, size_t *size)
+{
+    size_t header_len = scan_header_end(data, *size);
+    size_t used = headers_in_ ? header_len - 1 : header_len;
+    int ret = 0;
+    if (used > 0)
+        ret = this->HttpRequest::append(data, &used);
+    header_size_ += used;
+    if (ret != 0 || !headers_in_)
+    {
+        if (ret > 0)
+            *size = used;
+        return ret;
+    }
+
+    this->fill_header_map();
+    header_hook_->on_headers(this);
+    if (this->body_too_large())
+    {
+        this->reply_too_large();
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    size_t last = 1;
+    ret = this->HttpRequest::append(data + header_len - 1, &last);
+    header_size_ += last;
+    if (ret != 0)
+    {
+        if (ret > 0)
+            *size = header_len;
+        return ret;
+    }
+
+    size_t rest = *size - header_len;
+    if (rest == 0)
+        return 0;
+    ret = this->append(data + header_len, &rest);
+    if (ret > 0)
+        *size = header_len + rest;
+    return ret;
+}
+
+void HttpReq::set_body_limit(size_t limit)
+{
+    body_limit_ = limit;
+    // the parser counts the headers too
+    size_t max = static_cast<size_t>(-1);
+    this->set_size_limit(limit < max - header_size_ - 1 ? header_size_ + 1 + limit : max);
+}
+
+bool HttpReq::body_too_large() const
+{
+    if (body_limit_ == 0 || this->is_chunked())
+        return false;
+    size_t content_length = 0;
+    return NumUtil::parse(StrUtil::trim(this->header(HEADER_CONTENT_LENGTH)), content_length) &&
+           content_length > body_limit_;
+}
+
+void HttpReq::reply_too_large()
+{
+    static const char resp[] = "HTTP/1.1 413 Payload Too Large\r\n"
+                               "Content-Length: 0\r\n"
+                               "Connection: close\r\n\r\n";
+    this->feedback(resp, sizeof resp - 1);
+}
+
 // 获取表单形式的数据
 Form &HttpReq::form() const
 {
     if (content_type_ == MULTIPART_FORM_DATA && req_data_->form.empty())
     {
-        StringPiece body_piece(this->body());
-
-        req_data_->form = multi_part_.parse_multipart(body_piece);
+        // the last of a repeated name wins here, see form_view()
+        for (const FormView::Part &part : this->form_view())
+        {
+            if (part.name.empty())
+                continue;
+            auto &formdata = req_data_->form[part.name.as_string()];
+            formdata.first = part.filename.as_string();     // 文件名
+            formdata.second = part.data.as_string();        // 文件数据
+        }
     }
     return req_data_->form;
 }
 
+const FormView &HttpReq::form_view() const
+{
+    if (content_type_ == MULTIPART_FORM_DATA && !req_data_->form_view_parsed)
+    {
+        req_data_->form_view_parsed = true;
+        req_data_->form_view.parse(this->body_view(), multi_part_.boundary());
+    }
+    return req_data_->form_view;
+}
+
 // 获取 json 格式的请求数据
 Json &HttpReq::json() const
 {
-    if (content_type_ == APPLICATION_JSON && req_data_->json.empty())
+    if (content_type_ == APPLICATION_JSON && !req_data_->json_parsed)
     {
-        const std::string &body_content = this->body();
-        if (!Json::accept(body_content))
-        {
-            return req_data_->json;
-            // todo : how to let user know the error ?
-        }
-        req_data_->json = Json::parse(body_content); // Json::parse() : 解析，反序列化，将 json 格式的字符串 解析为 Json 格式数据
+        req_data_->json_parsed = true;
+        StringPiece body_content = this->body_view();
+        // 解析，反序列化，将 json 格式的字符串 解析为 Json 格式数据
+        JsonUtil::parse(body_content.data(), body_content.size(),
+                        req_data_->json, req_data_->json_error);
     }
     return req_data_->json;
 }
 
+const JsonError &HttpReq::json_error() const
+{
+    this->json();
+    return req_data_->json_error;
+}
+
 // 获取路由中的参数
-const std::string &HttpReq::param(const std::string &key) const
+StringPiece HttpReq::param(const StringPiece &key) const
 {
-    if (route_params_.count(key))
-        return route_params_.at(key);
+    const RouteParam *p = route_params_.find(key);
+    if (p)
+        return p->value;
     else
-        return string_not_found;
+        return StringPiece();
 }
 
 // 判断某个参数是否存在
-bool HttpReq::has_param(const std::string &key) const
+bool HttpReq::has_param(const StringPiece &key) const
+{
+    return route_params_.find(key) != nullptr;
+}
+
+const QueryParams &HttpReq::query_list() const
+{
+    if (!query_parsed_)
+    {
+        KvUtil::split(query_, KvSyntax::URLENCODED, query_params_, arena_.get());
+        query_parsed_ = true;
+    }
+    return query_params_;
+}
+
+const QueryParam *HttpReq::find_query(const StringPiece &key) const
 {
-    return route_params_.count(key) > 0;
+    for (const QueryParam &param : query_list())
+    {
+        if (param.key == key)
+            return &param;
+    }
+    return nullptr;
 }
 
 // 查询某个参数
-const std::string &HttpReq::query(const std::string &key) const
+StringPiece HttpReq::query(const StringPiece &key) const
 {
-    if (query_params_.count(key))
-        return query_params_.at(key);
+    const QueryParam *p = find_query(key);
+    if (p)
+        return p->value;
     else
-        return string_not_found;
+        return StringPiece();
 }
 
 // 默认查询某个参数，给某个参数设置指定值
-const std::string &HttpReq::default_query(const std::string &key, const std::string &default_val) const
+StringPiece HttpReq::default_query(const StringPiece &key, const StringPiece &default_val) const
 {
-    if (query_params_.count(key))
-        return query_params_.at(key);
+    const QueryParam *p = find_query(key);
+    if (p)
+        return p->value;
     else
         return default_val;
 }
 
-// 判断要查询的参数是否存在
-bool HttpReq::has_query(const std::string &key) const
+std::vector<StringPiece> HttpReq::query_all(const StringPiece &key) const
 {
-    if (query_params_.find(key) != query_params_.end())
-    {
-        return true;
-    } else
+    std::vector<StringPiece> res;
+    for (const QueryParam &param : query_list())
     {
-        return false;
+        if (param.key == key)
+            res.push_back(param.value);
     }
+    return res;
+}
+
+// 判断要查询的参数是否存在
+bool HttpReq::has_query(const StringPiece &key) const
+{
+    return find_query(key) != nullptr;
 }
 
 // 保存 请求头 中 content_type 部分数据
 void HttpReq::fill_content_type()
 {
-    const std::string &content_type_str = header("Content-Type");
+    StringPiece content_type_str = header(HEADER_CONTENT_TYPE);
     content_type_ = ContentType::to_enum(content_type_str);
 
     if (content_type_ == MULTIPART_FORM_DATA)
     {
         // if type is multipart form, we reserve the boudary first
-        const char *boundary = strstr(content_type_str.c_str(), "boundary=");
-        if (boundary == nullptr)
+        size_t boundary = content_type_str.find("boundary=");
+        if (boundary == std::string::npos)
         {
             return;
         }
-        boundary += strlen("boundary=");
-        StringPiece boundary_piece(boundary);
+        StringPiece boundary_piece(content_type_str);
+        boundary_piece.remove_prefix(boundary + strlen("boundary="));
 
         StringPiece boundary_str = StrUtil::trim_pairs(boundary_piece, R"(""'')");
         multi_part_.set_boundary(boundary_str.as_string()); // 设置 boundary_
@@ -434,35 +782,35 @@ void HttpReq::fill_content_type()
 }
 
 // 获取 请求头 中的字段的值
-const std::string &HttpReq::header(const std::string &key) const
+StringPiece HttpReq::header(const StringPiece &key) const
 {
-    const auto it = headers_.find(key);
-
-    if (it == headers_.end() || it->second.empty())
-        return string_not_found;
-
-    return it->second[0];
+    const HeaderField *field = headers_.find(key);
+    if (field)
+        return field->value;
+    else
+        return StringPiece();
 }
 
-bool HttpReq::has_header(const std::string &key) const
+bool HttpReq::has_header(const StringPiece &key) const
 {
-    return headers_.count(key) > 0;
+    return headers_.find(key) != nullptr;
 }
 
 // 将请求头信息中的字段 保存到 headers_ 中
+// only views into the parser, nothing is copied
 void HttpReq::fill_header_map()
 {
     http_header_cursor_t cursor;
     struct protocol::HttpMessageHeader header;
 
+    headers_.clear();
     http_header_cursor_init(&cursor, this->get_parser());
     while (http_header_cursor_next(&header.name, &header.name_len,
                                    &header.value, &header.value_len,
                                    &cursor) == 0)
     {
-        std::string key(static_cast<const char *>(header.name), header.name_len);
-
-        headers_[key].emplace_back(static_cast<const char *>(header.value), header.value_len);
+        headers_.add(StringPiece(header.name, header.name_len),
+                     StringPiece(header.value, header.value_len));
     }
 
     http_header_cursor_deinit(&cursor);
@@ -472,15 +820,28 @@ void HttpReq::fill_header_map()
 const std::map<std::string, std::string> &HttpReq::cookies() const
 {   
     // has_header("Cookie") 判断 header 中是否有 Cookie 字段，如果有，则将它进行切分获取响应的键值
-    if (cookies_.empty() && this->has_header("Cookie")) 
+    if (cookies_.empty())
     {
-        const std::string &cookie = this->header("Cookie");
-        StringPiece cookie_piece(cookie);
-        cookies_ = std::move(HttpCookie::split(cookie_piece));
+        for (const KeyValue &kv : this->cookie_list())
+            cookies_.emplace(kv.key.as_string(), kv.value.as_string());
     }
     return cookies_;
 }
 
+const KeyValues &HttpReq::cookie_list() const
+{
+    if (!req_data_->cookie_list_parsed)
+    {
+        req_data_->cookie_list_parsed = true;
+        if (this->has_header(HEADER_COOKIE))
+        {
+            KvUtil::split(this->header(HEADER_COOKIE), KvSyntax::COOKIE,
+                          req_data_->cookie_list, arena_.get());
+        }
+    }
+    return req_data_->cookie_list;
+}
+
 // 查询 指定 cookie 的值
 const std::string &HttpReq::cookie(const std::string &key) const
 {
@@ -495,21 +856,74 @@ const std::string &HttpReq::cookie(const std::string &key) const
     return string_not_found;
 }
 
+void HttpReq::pin_request_uri()
+{
+    const char *path = current_path_.data();
+    size_t path_len = current_path_.size();
+    const char *query = query_.data();
+    size_t query_len = query_.size();
+
+    // path, then query, in a buffer of our own
+    char *buf = static_cast<char *>(arena_->allocate(path_len + query_len + 1, 1));
+    memcpy(buf, path, path_len);
+    if (query_len)
+        memcpy(buf + path_len, query, query_len);
+
+    route_params_.rebase(path, path_len, buf);
+    const char *match = route_match_path_.data();
+    if (match && match >= path && match <= path + path_len)
+        route_match_path_.set(buf + (match - path), route_match_path_.size());
+    current_path_.set(buf, path_len);
+
+    char *query_buf = buf + path_len;
+    for (QueryParam &param : query_params_)
+    {
+        const char *key = param.key.data();
+        if (key >= query && key <= query + query_len)
+            param.key.set(query_buf + (key - query), param.key.size());
+        const char *val = param.value.data();
+        if (val && val >= query && val <= query + query_len)
+            param.value.set(query_buf + (val - query), param.value.size());
+    }
+    if (query)
+        query_.set(query_buf, query_len);
+}
+
 // 拷贝构造函数
 HttpReq::HttpReq(HttpReq&& other)
     : HttpRequest(std::move(other)),
+    arena_(std::move(other.arena_)),
     content_type_(other.content_type_),
-    route_match_path_(std::move(other.route_match_path_)),
-    route_full_path_(std::move(other.route_full_path_)),
+    route_match_path_(other.route_match_path_),
+    route_full_path_(other.route_full_path_),
     route_params_(std::move(other.route_params_)),
+    route_snapshot_(other.route_snapshot_),
+    route_options_(other.route_options_),
+    route_verb_handler_(other.route_verb_handler_),
+    route_status_(other.route_status_),
+    query_(other.query_),
+    query_parsed_(other.query_parsed_),
     query_params_(std::move(other.query_params_)),
     cookies_(std::move(other.cookies_)),
     multi_part_(std::move(other.multi_part_)),
     headers_(std::move(other.headers_)),
-    parsed_uri_(std::move(other.parsed_uri_))
+    context_(std::move(other.context_)),
+    header_hook_(other.header_hook_),
+    headers_in_(other.headers_in_),
+    header_end_(other.header_end_),
+    header_size_(other.header_size_),
+    body_limit_(other.body_limit_),
+    body_intake_(std::move(other.body_intake_)),
+    form_stream_(other.form_stream_),
+    body_spill_(other.body_spill_),
+    current_path_(other.current_path_),
+    current_path_buf_(std::move(other.current_path_buf_))
 {
     req_data_ = other.req_data_;
     other.req_data_ = nullptr;
+    other.route_snapshot_ = nullptr;
+    other.form_stream_ = nullptr;
+    other.body_spill_ = nullptr;
 }
 
 // 赋值构造函数
@@ -518,17 +932,40 @@ HttpReq &HttpReq::operator=(HttpReq&& other)
     HttpRequest::operator=(std::move(other));
     content_type_ = other.content_type_;
 
+    if (req_data_)
+        req_data_->~ReqData();
     req_data_ = other.req_data_;
     other.req_data_ = nullptr;
 
-    route_match_path_ = std::move(other.route_match_path_);
-    route_full_path_ = std::move(other.route_full_path_);
+    route_match_path_ = other.route_match_path_;
+    route_full_path_ = other.route_full_path_;
     route_params_ = std::move(other.route_params_);
+    set_route_snapshot(other.route_snapshot_);
+    other.route_snapshot_ = nullptr;
+    route_options_ = other.route_options_;
+    route_verb_handler_ = other.route_verb_handler_;
+    route_status_ = other.route_status_;
+    query_ = other.query_;
+    query_parsed_ = other.query_parsed_;
     query_params_ = std::move(other.query_params_);
     cookies_ = std::move(other.cookies_);
     multi_part_ = std::move(other.multi_part_);
     headers_ = std::move(other.headers_);
-    parsed_uri_ = std::move(other.parsed_uri_);
+    context_ = std::move(other.context_);
+    header_hook_ = other.header_hook_;
+    headers_in_ = other.headers_in_;
+    header_end_ = other.header_end_;
+    header_size_ = other.header_size_;
+    body_limit_ = other.body_limit_;
+    body_intake_ = std::move(other.body_intake_);
+    form_stream_ = other.form_stream_;
+    other.form_stream_ = nullptr;
+    body_spill_ = other.body_spill_;
+    other.body_spill_ = nullptr;
+    current_path_ = other.current_path_;
+    current_path_buf_ = std::move(other.current_path_buf_);
+    // last, nothing points into the old one any more
+    arena_ = std::move(other.arena_);
 
     return *this;
 }
@@ -565,12 +1002,17 @@ void HttpResp::String(std::string &&str)
 int HttpResp::compress(const std::string * const data, std::string *compress_data)
 {
     int status = StatusOK;
-    if (headers.find("Content-Encoding") != headers.end())
+    StringPiece encoding = this->known_header(HEADER_CONTENT_ENCODING);
+    if (encoding.data())
     {
-        if (headers["Content-Encoding"].find("gzip") != std::string::npos)
+        if (encoding.find("gzip") != std::string::npos)
         {
             status = Compressor::gzip(data, compress_data);
         }
+        else if (encoding.find("deflate") != std::string::npos)
+        {
+            status = Compressor::deflate(data->c_str(), data->size(), compress_data);
+        }
     } else 
     {
         status = StatusNoComrpess;
@@ -594,10 +1036,18 @@ void HttpResp::Error(int error_code, const std::string &errmsg)
     case StatusRouteNotFound:
         status_code = 404;
         break;
+    case StatusRouteParamInvalid:
+    case StatusRequestJsonInvalid:
+    case StatusFormInvalid:
+        status_code = 400;
+        break;
+    case StatusUncompressTooLarge:
+        status_code = 413;
+        break;
     default:
         break;
     }
-    this->headers["Content-Type"] = "application/json";
+    this->set_known_header_static(HEADER_CONTENT_TYPE, "application/json");
     this->set_status(status_code); 
     ::Json js;
     std::string resp_msg = error_code_to_str(error_code);
@@ -635,6 +1085,35 @@ void HttpResp::set_status(int status_code)
     protocol::HttpUtil::set_response_status(this, status_code);
 }
 
+void HttpResp::set_known_header(enum http_header_id id, const StringPiece &value)
+{
+    // the last write wins, whichever way it was made
+    if (!headers.empty())
+        headers.erase(KnownHeader::to_str(id));
+    header_fields_.set(id, value);
+}
+
+void HttpResp::set_known_header_static(enum http_header_id id, const StringPiece &value)
+{
+    if (!headers.empty())
+        headers.erase(KnownHeader::to_str(id));
+    header_fields_.set_static(id, value);
+}
+
+StringPiece HttpResp::known_header(enum http_header_id id) const
+{
+    if (!headers.empty())
+    {
+        const auto it = headers.find(KnownHeader::to_str(id));
+        if (it != headers.end())
+            return it->second;
+    }
+    const RespHeaders::Field *field = header_fields_.find(id);
+    if (field)
+        return field->value;
+    return StringPiece();
+}
+
 // 客户端上传文件
 void HttpResp::Save(const std::string &file_dst, const std::string &content)
 {
@@ -655,7 +1134,7 @@ void HttpResp::Json(const ::Json &json)
     // The header value itself does not allow for multiple values, 
     // and it is also not allowed to send multiple Content-Type headers
     // https://stackoverflow.com/questions/5809099/does-the-http-protocol-support-multiple-content-types-in-response-headers
-    this->headers["Content-Type"] = "application/json";
+    this->set_known_header_static(HEADER_CONTENT_TYPE, "application/json");
     this->String(json.dump());  // json.dump() 作用：将 json 数据 序列化 为字符串
 }
  
@@ -668,14 +1147,14 @@ void HttpResp::Json(const std::string &str)
         this->Error(StatusJsonInvalid);
         return;
     }
-    this->headers["Content-Type"] = "application/json";
+    this->set_known_header_static(HEADER_CONTENT_TYPE, "application/json");
     this->String(str);
 }
 
 void HttpResp::set_compress(const enum Compress &compress)
 {
     // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Content-Encoding
-    headers["Content-Encoding"] = compress_method_to_str(compress);
+    this->set_known_header_static(HEADER_CONTENT_ENCODING, compress_method_to_str(compress));
 }
 
 int HttpResp::get_state() const
@@ -727,6 +1206,7 @@ void HttpResp::Http(const std::string &url, int redirect_max, size_t size_limit)
     else
         route = "/";
 
+    server_req->pin_request_uri();      // the route params point into the old uri
 	server_req->set_request_uri(route);
 	server_req->get_parsed_body(&body, &len);
 	server_req->append_output_body_nocopy(body, len);
@@ -810,11 +1290,24 @@ void HttpResp::add_task(SubTask *task)
     **server_task << task;
 }
 
+HttpResp::HttpResp() : arena_(Arena::create()), user_data(nullptr),
+    header_fields_(arena_.get())
+{}
+
+HttpResp::HttpResp(HttpResponse && base_resp)
+    : HttpResponse(std::move(base_resp)),
+    arena_(Arena::create()),
+    user_data(nullptr),
+    header_fields_(arena_.get())
+{}
+
 // 拷贝构造函数
 HttpResp::HttpResp(HttpResp&& other)
     : HttpResponse(std::move(other)),
+    arena_(std::move(other.arena_)),
     headers(std::move(other.headers)),
-    cookies_(std::move(other.cookies_))
+    cookies_(std::move(other.cookies_)),
+    header_fields_(std::move(other.header_fields_))
 {
     user_data = other.user_data;
     other.user_data = nullptr;
@@ -828,9 +1321,93 @@ HttpResp &HttpResp::operator=(HttpResp&& other)
     user_data = other.user_data;
     other.user_data = nullptr;
     cookies_ = std::move(other.cookies_);
+    header_fields_ = std::move(other.header_fields_);
+    head_ = StringPiece();
+    // last, nothing points into the old one any more
+    arena_ = std::move(other.arena_);
     return *this;
 }
 
+// HttpMessage::encode() writes the start line, the headers of the protocol
+// message, the blank line and get_output_body_size() bytes of body, cut in
+// vectors any way it likes. head_ goes in right before the blank line, found
+// counting the bytes back from the end.
+int HttpResp::encode(struct iovec vectors[], int max)
+{
+    if (head_.empty())
+        return this->HttpResponse::encode(vectors, max);
+
+    // room for head_ and for the vector the blank line starts in, cut in two
+    if (max < 2)
+    {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    int cnt = this->HttpResponse::encode(vectors, max - 2);
+    if (cnt < 0)
+        return cnt;
+
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++)
+        total += vectors[i].iov_len;
+    size_t tail = this->get_output_body_size() + 2;
+    if (total < tail)
+    {
+        errno = EBADMSG;
+        return -1;
+    }
 
+    size_t pos = total - tail;
+    int i = 0;
+    while (pos >= vectors[i].iov_len)
+    {
+        pos -= vectors[i].iov_len;
+        i++;
+    }
+    if (static_cast<const char *>(vectors[i].iov_base)[pos] != '\r')
+    {
+        errno = EBADMSG;
+        return -1;
+    }
 
+    int added = pos > 0 ? 2 : 1;
+    memmove(&vectors[i + added], &vectors[i], (cnt - i) * sizeof (struct iovec));
+    if (pos > 0)
+    {
+        vectors[i].iov_len = pos;
+        vectors[i + 2].iov_base = static_cast<char *>(vectors[i + 2].iov_base) + pos;
+        vectors[i + 2].iov_len -= pos;
+        i++;
+    }
+    vectors[i].iov_base = const_cast<char *>(head_.data());
+    vectors[i].iov_len = head_.size();
+    return cnt + added;
+}
 
+bool HttpResp::head_splice_works()
+{
+    static const bool works = []()
+    {
+        static const char expected[] = "HTTP/1.1 200 OK\r\nX-Check: 1\r\nDate: x\r\n\r\nbody";
+        HttpResp resp;
+        resp.set_http_version("HTTP/1.1");
+        resp.set_status_code("200");
+        resp.set_reason_phrase("OK");
+        resp.add_header_pair("X-Check", "1");
+        resp.append_output_body_nocopy("body", 4);
+        resp.head_ = StringPiece("Date: x\r\n");
+
+        struct iovec vectors[16];
+        int cnt = resp.encode(vectors, 16);
+        std::string out;
+        for (int i = 0; i < cnt; i++)
+            out.append(static_cast<const char *>(vectors[i].iov_base), vectors[i].iov_len);
+        if (out == expected)
+            return true;
+
+        fprintf(stderr, "[WFREST] HttpMessage::encode() is not what HttpResp::encode() "
+                        "expects, response headers go through add_header()\n");
+        return false;
+    }();
+    return works;
+}
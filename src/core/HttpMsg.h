@@ -16,6 +16,14 @@
 #include "StrUtil.h"
 #include "HttpCookie.h"
 #include "Noncopyable.h"
+#include "RouteParams.h"
+#include "HeaderIndex.h"
+#include "RespHeaders.h"
+#include "NumUtil.h"
+#include "UriUtil.h"
+#include "KvUtil.h"
+#include "Arena.h"
+#include "JsonUtil.h"
 
 namespace protocol
 {
@@ -31,61 +39,178 @@ using Json = nlohmann::json;
 
 struct ReqData;
 class MySQL;
+class RouteSnapshot;
+struct VerbHandler;
+class HttpServerTask;
+struct RouteOptions;
+class HttpReq;
+class BodyPipe;
+class BodySpill;
+
+// Sees the headers of a request before its body is read, e.g. to hand
+// the body to a BodyConsumer. Runs in the network thread.
+class HeaderHook
+{
+public:
+    virtual ~HeaderHook() {}
+
+    virtual void on_headers(HttpReq *req) = 0;
+};
 
 // request 类
 class HttpReq : public protocol::HttpRequest, public Noncopyable
 {
 public:
+    // decoded if Content-Encoding is gzip or deflate. Empty for a spilled
+    // body that is not compressed, body_status() is then StatusBodySpilled :
+    // use body_view()
     std::string &body() const;
 
+    // StatusOK, StatusNoUncomrpess if the encoding is unknown and body() is
+    // the raw one, or why decoding failed and body() is empty
+    int body_status() const;
+
+    // Points into the parser buffer when the body is neither chunked nor
+    // compressed, otherwise it is body(). Valid as long as the request.
+    // A spilled body is an mmap of its temp file.
+    StringPiece body_view() const;
+
+    // went to a temp file, see RouteOptions::body_memory_limit
+    bool body_spilled() const;
+
     // post body
     std::map<std::string, std::string> &form_kv() const;
 
+    // application/x-www-form-urlencoded, in order, repeated keys included,
+    // decoded. Valid as long as the request.
+    const KeyValues &form_list() const;
+
     Form &form() const;
 
+    // multipart/form-data in place : no copies, repeated fields and the
+    // headers of each part kept. Valid as long as the request.
+    const FormView &form_view() const;
+
+    // parts of a streamed multipart body, see RouteOptions::stream_multipart.
+    // body_status() says if the body was cut short or could not be spooled.
+    const FormParts &form_parts() const;
+
+    // multipart/form-data boundary, empty for anything else
+    const std::string &boundary() const
+    { return multi_part_.boundary(); }
+
+    // parsed once, discarded if the body is not valid json
     Json &json() const;
 
+    // why json() is discarded, msg is empty if it parsed
+    // e.g. resp->Error(StatusRequestJsonInvalid, req->json_error().msg);
+    const JsonError &json_error() const;
+
     http_content_type content_type() const
     { return content_type_; }
 
     // 获取 请求头 中的字段的值
-    const std::string &header(const std::string &key) const;
+    // case insensitive, empty if missing, valid as long as the request
+    StringPiece header(const StringPiece &key) const;
     // 判断 指定 header 的字段是否存在
-    bool has_header(const std::string &key) const;
+    bool has_header(const StringPiece &key) const;
+
+    // HTTP_KNOWN_HEADER_MAP headers, by slot
+    StringPiece header(enum http_header_id id) const
+    {
+        const HeaderField *field = headers_.find(id);
+        return field ? field->value : StringPiece();
+    }
+
+    bool has_header(enum http_header_id id) const
+    { return headers_.find(id) != nullptr; }
+
+    // every header, in the order they came in
+    const HeaderIndex &headers() const
+    { return headers_; }
+
+    // view into the request path, valid as long as the request
+    StringPiece param(const StringPiece &key) const;
+
+    template<typename T>
+    T param(const StringPiece &key) const;
+
+    // false if the param is missing or does not fit in T, never throws
+    template<typename T>
+    bool param(const StringPiece &key, OUT T &val) const;
+
+    bool has_param(const StringPiece &key) const;
 
-    const std::string &param(const std::string &key) const;
+    const RouteParams &params() const
+    { return route_params_; }
+
+    // The query is parsed on the first of these calls.
+    // Keys and values are percent-decoded, "+" is a space.
+    // The first value if the key is repeated, empty if missing.
+    StringPiece query(const StringPiece &key) const;
 
     template<typename T>
-    T param(const std::string &key) const;
+    T query(const StringPiece &key) const;
 
-    bool has_param(const std::string &key) const;
+    // false if the key is missing or does not fit in T, never throws
+    template<typename T>
+    bool query(const StringPiece &key, OUT T &val) const;
 
-    const std::string &query(const std::string &key) const;
+    StringPiece default_query(const StringPiece &key,
+                              const StringPiece &default_val) const;
 
-    const std::string &default_query(const std::string &key,
-                                     const std::string &default_val) const;
+    // every value of a repeated key, in order
+    std::vector<StringPiece> query_all(const StringPiece &key) const;
 
-    // 返回 请求中的参数的 map 集合
-    const std::map<std::string, std::string> &query_list() const
-    { return query_params_; }
+    // 返回 请求中的参数
+    const QueryParams &query_list() const;
 
-    bool has_query(const std::string &key) const;
+    bool has_query(const StringPiece &key) const;
 
     // 返回 匹配的路由
-    const std::string &match_path() const
+    StringPiece match_path() const
     { return route_match_path_; }
 
     // handler define path
     const std::string &full_path() const
-    { return route_full_path_; }
+    { return route_full_path_ ? *route_full_path_ : string_not_found; }
 
     // 返回当前路由
-    std::string current_path() const
-    { return parsed_uri_.path; }
+    // normalised, no "//", "." or ".." segments, valid as long as the request
+    StringPiece current_path() const
+    { return current_path_; }
+
+    // what Router::match() found : StatusOK with the route and its options,
+    // or why there is no handler. -1 and nullptr until it ran.
+    int route_status() const
+    { return route_status_; }
+
+    const VerbHandler *route_verb_handler() const
+    { return route_verb_handler_; }
+
+    const RouteOptions *route_options() const
+    { return route_options_; }
 
     const std::map<std::string, std::string> &cookies() const;  // 获取 cookies 信息
     
     const std::string &cookie(const std::string &key) const;    // 查询 指定 cookie 的值
+
+    // the Cookie header, in order, decoded. Valid as long as the request.
+    const KeyValues &cookie_list() const;
+
+    // Memory that goes away with the request, all at once. What the request
+    // parses lazily lives here too.
+    Arena *arena() const
+    { return arena_.get(); }
+
+    // What the POST_STREAM() handlers of one request share, e.g. the file
+    // on_headers opens, on_chunk writes and the handler closes.
+    void set_context(std::shared_ptr<void> context)
+    { context_ = std::move(context); }
+
+    template<typename T>
+    T *context() const
+    { return static_cast<T *>(context_.get()); }
 public:
     void fill_content_type();   // 保存 请求头 中 content_type 部分数据
 
@@ -93,31 +218,87 @@ public:
 
     // 设置 路由参数
     // /{name}/{id} params in route
-    void set_route_params(std::map<std::string, std::string> &&params)
-    { route_params_ = std::move(params); }
+    void set_route_params(const RouteParams &params)
+    { route_params_ = params; }
 
     // /match*  
     // /match123 -> match123
-    void set_route_match_path(const std::string &match_path)
+    void set_route_match_path(const StringPiece &match_path)
     { route_match_path_ = match_path; }
 
-    void set_full_path(const std::string &route_full_path)
+    // owned by the route table
+    void set_full_path(const std::string *route_full_path)
     { route_full_path_ = route_full_path; }
 
+    // takes over a reference, released with the request
+    void set_route_snapshot(const RouteSnapshot *snapshot);
+
+    // owned by the route snapshot
+    void set_route_options(const RouteOptions *options)
+    { route_options_ = options; }
+
+    // owned by the route snapshot
+    void set_route_verb_handler(const VerbHandler *vh)
+    { route_verb_handler_ = vh; }
+
+    void set_route_status(int status)
+    { route_status_ = status; }
+
     // 保存 请求中的参数
-    void set_query_params(std::map<std::string, std::string> &&query_params)
-    { query_params_ = std::move(query_params); }
+    // a view into the request uri, parsed on demand
+    void set_query(const StringPiece &query)
+    {
+        query_ = query;
+        query_parsed_ = false;
+    }
+
+    // 保存 解析到的 path
+    // path points into the request uri, or into path_buf if it was normalised
+    void set_current_path(const StringPiece &path, std::unique_ptr<char[]> &&path_buf)
+    {
+        current_path_ = path;
+        current_path_buf_ = std::move(path_buf);
+    }
+
+    // copy the path and the query out of the request uri, with the views
+    // into them, before the request uri is changed
+    void pin_request_uri();
+
+    void set_header_hook(HeaderHook *hook)
+    { header_hook_ = hook; }
+
+    // From HeaderHook::on_headers(), in place of the size limit of the
+    // server : a larger Content-Length gets 413 before any of the body is
+    // read or 100 Continue is sent, a chunked body is cut off past it.
+    void set_body_limit(size_t limit);
+
+    // the body goes to stream instead of the parser, from HeaderHook::on_headers()
+    void stream_form(MultiPartStream *stream);
 
-    // 保存 解析到的 uri
-    void set_parsed_uri(ParsedURI &&parsed_uri)
-    { parsed_uri_ = std::move(parsed_uri); }
+    // the same for a POST_STREAM() route
+    void stream_body(BodyPipe *pipe);
+
+    // and for a body that may spill to a temp file
+    void spill_body(BodySpill *spill);
+
+    // unmaps and removes the temp file of a spilled body
+    void release_spilled_body();
+
+    // to run before the handler, see BodyConsumer::create_barrier()
+    SubTask *body_barrier() const;
+
+    // false if the request can go right away, see BodyConsumer::release_later()
+    bool release_later(std::function<void()> release);
+
+protected:
+    // headers to the parser, the body to body_intake_ if there is one
+    int append(const void *buf, size_t *size) override;
 
 public:
     HttpReq();
 
-    HttpReq(HttpRequest &&base_req) 
-        : HttpRequest(std::move(base_req))
-    {}
+    // keeps the protocol message, the rest starts out like HttpReq()
+    HttpReq(HttpRequest &&base_req);
 
     ~HttpReq();
 
@@ -126,53 +307,127 @@ public:
     HttpReq &operator=(HttpReq&& other);
 
 private:
-    using HeaderMap = std::map<std::string, std::vector<std::string>, MapStringCaseLess>;
-    
+    const QueryParam *find_query(const StringPiece &key) const;
+
+    // into ReqData::body once, but a spilled body that is not compressed
+    void decode_body() const;
+
+    // up to the blank line after the headers, all of len if it is not in data
+    size_t scan_header_end(const char *data, size_t len);
+
+    // append() until the headers are in and through header_hook_
+    int append_headers(const char *data, size_t *size);
+
+    // Content-Length past body_limit_, nothing is read past the headers
+    bool body_too_large() const;
+
+    // 413 straight to the connection, which then closes
+    void reply_too_large();
+
+    void set_body_consumer(BodyConsumer *consumer);
+
+private:
+    ArenaPtr arena_;                    // first, so it goes after everything in it
     http_content_type content_type_;    // 保存 content_type 字段
     ReqData *req_data_;                 // 请求的数据 结构体
 
-    // 下面三个变量的设置 是在 Router.cc 文件的 call() 函数设置的
-    std::string route_match_path_;                      // 路由中匹配到的路径
-    std::string route_full_path_;                       // 路由中匹配到的完整路径
-    std::map<std::string, std::string> route_params_;   // 存储路由中的参数
+    // 下面三个变量的设置 是在 Router.cc 文件的 match() 函数设置的
+    StringPiece route_match_path_;                      // 路由中匹配到的路径
+    const std::string *route_full_path_;                // 路由中匹配到的完整路径
+    RouteParams route_params_;                          // 存储路由中的参数
+    const RouteSnapshot *route_snapshot_;               // owns the three above
+    const RouteOptions *route_options_;                 // nullptr : the defaults
+    const VerbHandler *route_verb_handler_;             // the snapshot owns these two as well
+    int route_status_;                                  // -1 : not matched yet
 
 
-    std::map<std::string, std::string> query_params_;   // 存储路由中要查询的参数
+    StringPiece query_;                                 // 请求中的参数, not parsed yet
+    mutable bool query_parsed_;
+    mutable QueryParams query_params_;                  // 存储路由中要查询的参数, decoded in arena_
     mutable std::map<std::string, std::string> cookies_;    // 存储 cookie 信息
 
     MultiPartForm multi_part_;  // 表单格式的数据
-    HeaderMap headers_;         // 保存 请求头 字段的键值
+    HeaderIndex headers_;       // 保存 请求头 字段的键值
+
+    std::shared_ptr<void> context_;     // before body_intake_, on_chunk may use it
 
-    ParsedURI parsed_uri_;      // 解析到的 uri
+    HeaderHook *header_hook_;
+    bool headers_in_;
+    unsigned char header_end_;                  // how far into the blank line
+    size_t header_size_;                        // given to the parser so far
+    size_t body_limit_;                         // 0 : the size limit of the server
+    std::unique_ptr<BodyIntake> body_intake_;   // the body bypasses the parser
+    MultiPartStream *form_stream_;              // owned by body_intake_
+    BodySpill *body_spill_;                     // owned by body_intake_
+
+    StringPiece current_path_;                      // 解析到的 path
+    std::unique_ptr<char[]> current_path_buf_;      // set if current_path_ was rewritten
 };
 
 // 获取 路由中的参数
+// 0 if the param is missing or is not a number
 template<>
-inline int HttpReq::param<int>(const std::string &key) const
+inline int HttpReq::param<int>(const StringPiece &key) const
 {
-    if (route_params_.count(key))
-        return std::stoi(route_params_.at(key));
-    else
-        return 0;
+    int val = 0;
+    param(key, val);
+    return val;
 }
 
 // 获取 路由中的参数
 template<>
-inline size_t HttpReq::param<size_t>(const std::string &key) const
+inline size_t HttpReq::param<size_t>(const StringPiece &key) const
+{
+    size_t val = 0;
+    param(key, val);
+    return val;
+}
+
+template<>
+inline double HttpReq::param<double>(const StringPiece &key) const
+{
+    double val = 0.0;
+    param(key, val);
+    return val;
+}
+
+template<typename T>
+bool HttpReq::param(const StringPiece &key, OUT T &val) const
+{
+    const RouteParam *p = route_params_.find(key);
+    return p && NumUtil::parse(p->value, val);
+}
+
+// 0 if the key is missing or is not a number
+template<>
+inline int HttpReq::query<int>(const StringPiece &key) const
+{
+    int val = 0;
+    query(key, val);
+    return val;
+}
+
+template<>
+inline size_t HttpReq::query<size_t>(const StringPiece &key) const
 {
-    if (route_params_.count(key))
-        return static_cast<size_t>(std::stoul(route_params_.at(key)));
-    else
-        return 0;
+    size_t val = 0;
+    query(key, val);
+    return val;
 }
 
 template<>
-inline double HttpReq::param<double>(const std::string &key) const
+inline double HttpReq::query<double>(const StringPiece &key) const
+{
+    double val = 0.0;
+    query(key, val);
+    return val;
+}
+
+template<typename T>
+bool HttpReq::query(const StringPiece &key, OUT T &val) const
 {
-    if (route_params_.count(key))
-        return std::stod(route_params_.at(key));
-    else
-        return 0.0;
+    const QueryParam *p = find_query(key);
+    return p && NumUtil::parse(p->value, val);
 }
 
 
@@ -209,7 +464,25 @@ public:
     void Json(const std::string &str);
 
     void set_status(int status_code);
-    
+
+    // Response headers, sent in this order. Set them here rather than
+    // through headers, the map is only kept for old code :
+    // headers[name], if it is set, still wins.
+    RespHeaders &header_fields()
+    { return header_fields_; }
+
+    const RespHeaders &header_fields() const
+    { return header_fields_; }
+
+    // HTTP_KNOWN_HEADER_MAP headers, the value is copied
+    void set_known_header(enum http_header_id id, const StringPiece &value);
+
+    // for a value that outlives the response, e.g. a literal
+    void set_known_header_static(enum http_header_id id, const StringPiece &value);
+
+    // what will be sent, data() is nullptr if it is not set
+    StringPiece known_header(enum http_header_id id) const;
+
     // Compress
     void set_compress(const Compress &compress);
 
@@ -264,17 +537,25 @@ public:
 
     void Error(int error_code, const std::string &errmsg);
 
+    // Whether encode() can put the headers in what HttpMessage::encode() of
+    // the linked workflow writes. Checked once on a made up response, if not
+    // HttpServerTask adds them to the protocol message one by one instead.
+    static bool head_splice_works();
+
+protected:
+    // the headers written by HttpServerTask go out as one iovec, before
+    // the blank line
+    int encode(struct iovec vectors[], int max) override;
+
 private:
     int compress(const std::string * const data, std::string *compress_data);
 
     void add_task(SubTask *task);
 
 public:
-    HttpResp() = default;
+    HttpResp();
 
-    HttpResp(HttpResponse && base_resp) 
-        : HttpResponse(std::move(base_resp))
-    {}
+    HttpResp(HttpResponse && base_resp);
 
     ~HttpResp() = default;
 
@@ -282,12 +563,21 @@ public:
 
     HttpResp &operator=(HttpResp&& other);
     
+private:
+    ArenaPtr arena_;                    // first, so it goes after everything in it
+
 public:
     std::map<std::string, std::string, MapStringCaseLess> headers;
     void *user_data;
 
 private:
     std::vector<HttpCookie> cookies_;
+    RespHeaders header_fields_;         // in arena_
+    // All the headers, set by HttpServerTask::message_out(), in arena_.
+    // encode() sends them after the ones of the protocol message.
+    StringPiece head_;
+
+    friend class HttpServerTask;
 };
 
 using HttpTask = WFNetworkTask<HttpReq, HttpResp>;
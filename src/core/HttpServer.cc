@@ -10,9 +10,34 @@
 #include "Macro.h"
 #include "Router.h"
 #include "ErrorCode.h"
+#include "BodyPipe.h"
+#include "BodySpill.h"
+#include "HttpDate.h"
 
 using namespace wfrest;
 
+namespace
+{
+
+// Allow : the verbs of the published routes, and OPTIONS, answered here
+void answer_server_options(unsigned verbs, HttpResp *resp)
+{
+    verbs |= 1u << static_cast<int>(Verb::OPTIONS);
+    std::string allow;
+    for (int i = static_cast<int>(Verb::ANY) + 1; i < k_verb_count; i++)
+    {
+        if (!(verbs & (1u << i)))
+            continue;
+        if (!allow.empty())
+            allow.append(", ");
+        allow.append(verb_to_str(static_cast<Verb>(i)));
+    }
+    resp->header_fields().set("Allow", allow);
+    resp->set_status(HttpStatusOK);
+}
+
+}  // namespace
+
 // 该函数是获取请求过来的参数
 void HttpServer::process(HttpTask *task)
 {
@@ -21,10 +46,16 @@ void HttpServer::process(HttpTask *task)
     auto *req = server_task->get_req();
     auto *resp = server_task->get_resp();
     
-    req->fill_header_map();     // 将请求头信息中的字段 保存到 headers_ 中
+    // A streamed body still being written. First, the request must not go
+    // before it is done, whatever the reply.
+    SubTask *barrier = req->body_barrier();
+    if (barrier)
+        **server_task << barrier;
+
+    // the headers were indexed by HttpServerTask::handle()
     req->fill_content_type();   // 保存 请求头 中 content_type 部分数据
 
-    const std::string &host = req->header("Host");  // 获取 请求头 中的字段的值
+    StringPiece host = req->header(HEADER_HOST);  // 获取 请求头 中的字段的值
     
     if (host.empty())
     {
@@ -33,36 +64,77 @@ void HttpServer::process(HttpTask *task)
         return;
     }
 
-    std::string request_uri = "http://" + host + req->get_request_uri();  // or can't parse URI
-    ParsedURI uri;
-    // uri 解析
-    if (URIParser::parse(request_uri, uri) < 0)
+    const char *method = req->get_method();    // 保存 http 请求 的 动词
+    Verb verb = str_to_verb(method, strlen(method));
+
+    // on_headers() has set them already, when the routes take bodies their own way
+    if (req->current_path().empty())
     {
-        resp->set_status(HttpStatusBadRequest);
-        return;
-    }
+        // the path and the query are views into the request uri, see UriUtil::parse_target()
+        const char *request_uri = req->get_request_uri();
+        RequestTarget target;
+        std::unique_ptr<char[]> path_buf;
+        if (!request_uri ||
+            UriUtil::parse_target(request_uri, strlen(request_uri), target, path_buf) < 0)
+        {
+            resp->set_status(HttpStatusBadRequest);
+            return;
+        }
 
-    std::string route;
+        if (target.asterisk())
+        {
+            // "OPTIONS *" asks about the server, no route is for it
+            if (verb == Verb::OPTIONS)
+                answer_server_options(blue_print_.router().verbs(), resp);
+            else
+                resp->set_status(HttpStatusBadRequest);
+            return;
+        }
 
-    if (uri.path && uri.path[0])
-        route = uri.path;
-    else
-        route = "/";
+        req->set_query(target.query);   // 保存 请求中的参数, parsed on first use
 
-    if (uri.query)
+        // lives as long as req, the route params are views into it
+        req->set_current_path(target.path, std::move(path_buf));
+    }
+    StringPiece route = req->current_path();
+
+    if (req->body_spilled())
     {
-        StringPiece query(uri.query);
-        req->set_query_params(UriUtil::split_query(query)); // 保存 请求中的参数
+        // the reply is out, nothing maps the file any more
+        server_task->add_callback([req](HttpTask *) { req->release_spilled_body(); });
     }
 
-    req->set_parsed_uri(std::move(uri));    // 保存 解析到的 uri
-    std::string verb = req->get_method();   // 保存 http 请求 的 动词
-    // call() 函数中设置了 路由的完整路径、路由中的参数、路由中匹配到的路径 等信息
+    if (barrier)
+    {
+        // a handler without a compute queue would run right away in Router::run()
+        **server_task << WFTaskFactory::create_counter_task(0,
+            [this, server_task, verb, route](WFCounterTask *)
+        {
+            this->dispatch(server_task, verb, route);
+        });
+        return;
+    }
+    dispatch(server_task, verb, route);
+}
+
+void HttpServer::dispatch(HttpServerTask *server_task, Verb verb, const StringPiece &route)
+{
+    auto *req = server_task->get_req();
+    auto *resp = server_task->get_resp();
+    const char *method = req->get_method();
+
+    // match() 函数中设置了 路由的完整路径、路由中的参数、路由中匹配到的路径 等信息
     // 即：route_full_path_ 、route_params_ 、route_match_path_ 
-    int ret = blue_print_.router().call(str_to_verb(verb), route, server_task); 
-    if(ret != StatusOK)
+    // on_headers() may have matched the request already
+    int ret = req->route_status();
+    if (ret < 0)
+        ret = blue_print_.router().match(verb, route, req);
+    if(ret == StatusOK)
     {
-        resp->Error(ret, verb + " " + route);
+        Router::run(verb, server_task);
+    } else
+    {
+        resp->Error(ret, std::string(method) + " " + route.as_string());
     }
     if(track_func_)
     {
@@ -77,10 +149,73 @@ CommSession *HttpServer::new_session(long long seq, CommConnection *conn)
     task->set_keep_alive(this->params.keep_alive_timeout);
     task->set_receive_timeout(this->params.receive_timeout);
     task->get_req()->set_size_limit(this->params.request_size_limit);
+    if (blue_print_.router().intercepts_body())
+        task->get_req()->set_header_hook(this);
 
     return task;
 }
 
+// network thread, the body is not read yet
+void HttpServer::on_headers(HttpReq *req)
+{
+    const char *request_uri = req->get_request_uri();
+    RequestTarget target;
+    std::unique_ptr<char[]> path_buf;
+    if (!request_uri ||
+        UriUtil::parse_target(request_uri, strlen(request_uri), target, path_buf) < 0 ||
+        target.asterisk())
+        return;     // process() answers
+
+    // matched once, here : process() and the handler use what is on req
+    req->set_query(target.query);
+    req->set_current_path(target.path, std::move(path_buf));
+    const char *method = req->get_method();
+    Verb verb = str_to_verb(method, strlen(method));
+    if (blue_print_.router().match(verb, req->current_path(), req) != StatusOK)
+        return;
+
+    const RouteOptions *options = req->route_options();
+    if (options->max_body_size > 0)
+        req->set_body_limit(options->max_body_size);
+
+    if (options->stream && options->stream->verb == verb)
+    {
+        int status = StatusOK;
+        if (options->stream->on_headers)
+            status = options->stream->on_headers(req);
+        req->stream_body(new BodyPipe(req, options->stream, options->stream_buffer_limit,
+                                      spool_dir_, &spilled_bytes_, status));
+        return;
+    }
+
+    req->fill_content_type();
+    if (options->stream_multipart &&
+        req->content_type() == MULTIPART_FORM_DATA && !req->boundary().empty())
+    {
+        req->stream_form(new MultiPartStream(req->boundary(), options->multipart_memory_limit,
+                                             spool_dir_));
+        return;
+    }
+
+    // a body known to fit stays with the parser
+    size_t content_length = 0;
+    if (options->body_memory_limit > 0 &&
+        (req->is_chunked() ||
+         (NumUtil::parse(StrUtil::trim(req->header(HEADER_CONTENT_LENGTH)), content_length) &&
+          content_length > options->body_memory_limit)))
+    {
+        req->spill_body(new BodySpill(options->body_memory_limit, spool_dir_, &spilled_bytes_));
+    }
+}
+
+// start() and serve() both come here before the first request is accepted
+int HttpServer::create_listen_fd()
+{
+    blue_print_.router_.publish();
+    HttpResp::head_splice_works();      // says so now if it does not
+    return this->WFServer<HttpReq, HttpResp>::create_listen_fd();
+}
+
 // 列出 路由
 void HttpServer::list_routes()
 {
@@ -117,7 +252,7 @@ int HttpServer::serve_static(const char* path, OUT BluePrint &bp)
         return StatusNotFound;
     }    
     bp.GET("/*", [path_str, is_file](const HttpReq *req, HttpResp *resp) {
-        std::string match_path = req->match_path();
+        std::string match_path = req->match_path().as_string();
         if(is_file && match_path.empty())
         {
             resp->File(path_str);
@@ -136,15 +271,16 @@ HttpServer &HttpServer::track()
         HttpResp *resp = server_task->get_resp();
         HttpReq *req = server_task->get_req();
         HttpServerTask *task = static_cast<HttpServerTask *>(server_task);
-        Timestamp current_time = Timestamp::now();
-        std::string fmt_time = current_time.to_format_str();
+        char fmt_time[HttpDate::k_log_len];
+        HttpDate::now_log(fmt_time);
         // time | http status code | peer ip address | verb | route path
-        fprintf(stderr, "[WFREST] %s | %s | %s | %s | \"%s\" | -- \n", 
-                    fmt_time.c_str(),
+        StringPiece path = req->current_path();
+        fprintf(stderr, "[WFREST] %.*s | %s | %s | %s | \"%.*s\" | -- \n", 
+                    static_cast<int>(HttpDate::k_log_len), fmt_time,
                     resp->get_status_code(),
                     task->get_peer_addr_str().c_str(), 
                     req->get_method(),
-                    req->current_path().c_str());
+                    static_cast<int>(path.size()), path.data());
     };
     return *this;
 }
@@ -4,6 +4,7 @@
 #include "workflow/WFHttpServer.h"
 #include "workflow/HttpUtil.h"
 
+#include <atomic>
 #include <unordered_map>
 #include <string>
 
@@ -13,7 +14,7 @@
 namespace wfrest
 {
 
-class HttpServer : public WFServer<HttpReq, HttpResp>, public Noncopyable
+class HttpServer : public WFServer<HttpReq, HttpResp>, public HeaderHook, public Noncopyable
 {
 public:
     // reserve basic interface
@@ -397,11 +398,155 @@ public:
         blue_print_.HEAD(route, compute_queue_id, handler, ap...);
     }
 
+public:
+    // Typed params, see TypedRoute.h
+    template<typename T, typename... Args>
+    void ROUTE(const char *route,
+               const typename TypedHandler<T, Args...>::type &handler, Verb verb)
+    {
+        blue_print_.ROUTE<T, Args...>(route, handler, verb);
+    }
+
+    template<typename T, typename... Args>
+    void ROUTE(const char *route, int compute_queue_id,
+               const typename TypedHandler<T, Args...>::type &handler, Verb verb)
+    {
+        blue_print_.ROUTE<T, Args...>(route, compute_queue_id, handler, verb);
+    }
+
+    template<typename T, typename... Args>
+    void GET(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.GET<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void GET(const char *route, int compute_queue_id,
+             const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.GET<T, Args...>(route, compute_queue_id, handler);
+    }
+
+    template<typename T, typename... Args>
+    void POST(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.POST<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void POST(const char *route, int compute_queue_id,
+              const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.POST<T, Args...>(route, compute_queue_id, handler);
+    }
+
+    template<typename T, typename... Args>
+    void DELETE(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.DELETE<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void DELETE(const char *route, int compute_queue_id,
+                const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.DELETE<T, Args...>(route, compute_queue_id, handler);
+    }
+
+    template<typename T, typename... Args>
+    void PATCH(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.PATCH<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void PATCH(const char *route, int compute_queue_id,
+               const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.PATCH<T, Args...>(route, compute_queue_id, handler);
+    }
+
+    template<typename T, typename... Args>
+    void PUT(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.PUT<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void PUT(const char *route, int compute_queue_id,
+             const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.PUT<T, Args...>(route, compute_queue_id, handler);
+    }
+
+    template<typename T, typename... Args>
+    void HEAD(const char *route, const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.HEAD<T, Args...>(route, handler);
+    }
+
+    template<typename T, typename... Args>
+    void HEAD(const char *route, int compute_queue_id,
+              const typename TypedHandler<T, Args...>::type &handler)
+    {
+        blue_print_.HEAD<T, Args...>(route, compute_queue_id, handler);
+    }
+
+public:
+    // see BluePrint::POST_STREAM
+    void POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const Handler &on_end)
+    {
+        blue_print_.POST_STREAM(route, on_headers, on_chunk, on_end);
+    }
+
+    void POST_STREAM(const char *route, int compute_queue_id,
+                     const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const Handler &on_end)
+    {
+        blue_print_.POST_STREAM(route, compute_queue_id, on_headers, on_chunk, on_end);
+    }
+
+    void POST_STREAM(const char *route, const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const SeriesHandler &on_end)
+    {
+        blue_print_.POST_STREAM(route, on_headers, on_chunk, on_end);
+    }
+
+    void POST_STREAM(const char *route, int compute_queue_id,
+                     const StreamHeadersHandler &on_headers,
+                     const StreamChunkHandler &on_chunk, const SeriesHandler &on_end)
+    {
+        blue_print_.POST_STREAM(route, compute_queue_id, on_headers, on_chunk, on_end);
+    }
+
 public:
     void Static(const char *relative_path, const char *root);
 
     void list_routes();
 
+    // how often the parameter-free fast path was taken
+    RouterStats router_stats() const
+    { return blue_print_.router().stats(); }
+
+    // see Router::set_match_cache
+    void set_match_cache(bool enable)
+    { blue_print_.router_.set_match_cache(enable); }
+
+    // Runtime route updates.
+    // Once the server is started, GET()/POST()/..., register_blueprint() and
+    // remove_route() only change a draft, publish_routes() swaps it in
+    // without blocking the requests. Call them from one thread at a time.
+    bool remove_route(const char *route, Verb verb)
+    { return blue_print_.router_.remove(route, verb); }
+
+    void publish_routes()
+    { blue_print_.router_.publish(); }
+
+    // e.g. server.route_options("/upload").max_decoded_body = 1 << 30;
+    RouteOptions &route_options(const char *route)
+    { return blue_print_.router_.route_options(route); }
+
     void register_blueprint(const BluePrint &bp, const std::string &url_prefix);
     
     template <typename... AP>
@@ -452,6 +597,19 @@ public:
         return *this;
     }
 
+    // where streamed multipart parts, spilled bodies and the POST_STREAM()
+    // bodies on_chunk falls behind on are spooled, /tmp by default
+    HttpServer &spool_dir(const std::string &spool_dir)
+    {
+        spool_dir_ = spool_dir;
+        return *this;
+    }
+
+    // request body bytes written to temp files so far,
+    // see RouteOptions::body_memory_limit and stream_buffer_limit
+    size_t spilled_bytes() const
+    { return spilled_bytes_.load(std::memory_order_relaxed); }
+
     using TrackFunc = std::function<void(HttpTask *server_task)>;
     
     HttpServer &track();
@@ -463,9 +621,16 @@ public:
 protected:
     CommSession *new_session(long long seq, CommConnection *conn) override;
 
+    int create_listen_fd() override;
+
+    void on_headers(HttpReq *req) override;
+
 private:
     void process(HttpTask *task);
 
+    // the route's handler, once the body is through, see HttpReq::body_barrier()
+    void dispatch(HttpServerTask *server_task, Verb verb, const StringPiece &route);
+
     int serve_static(const char *path, OUT BluePrint &bp);
     
     struct GlobalAspectFunc 
@@ -482,6 +647,8 @@ private:
 private:
     BluePrint blue_print_;
     TrackFunc track_func_;
+    std::string spool_dir_ = "/tmp";
+    std::atomic<size_t> spilled_bytes_{0};
 };
 
 }  // namespace wfrest
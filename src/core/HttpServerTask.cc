@@ -2,9 +2,11 @@
 #include "workflow/HttpMessage.h"
 
 #include <arpa/inet.h>
+#include <string.h>
 
 #include "HttpServerTask.h"
 #include "StrUtil.h"
+#include "HttpDate.h"
 
 using namespace wfrest;
 using namespace protocol;
@@ -12,6 +14,58 @@ using namespace protocol;
 #define HTTP_KEEPALIVE_DEFAULT    (60 * 1000)
 #define HTTP_KEEPALIVE_MAX        (300 * 1000)
 
+namespace
+{
+
+// a head buffer past this is not kept for the next response
+const size_t k_max_kept_head = 16 * 1024;
+
+// Where message_out() writes the headers before they go to the arena of
+// the response : reused by every response of the thread.
+std::string &head_scratch()
+{
+    static thread_local std::string head;
+    if (head.capacity() > k_max_kept_head)
+        std::string().swap(head);
+    head.clear();
+    return head;
+}
+
+// "name: value\r\n" lines, the way add_header() wants them
+void add_head_fields(HttpResponse *resp, const std::string &head)
+{
+    size_t pos = 0;
+    while (pos < head.size())
+    {
+        size_t eol = head.find("\r\n", pos);
+        size_t colon = head.find(": ", pos);
+        if (eol == std::string::npos || colon == std::string::npos || colon > eol)
+            break;
+
+        struct HttpMessageHeader header;
+        header.name = head.data() + pos;
+        header.name_len = colon - pos;
+        header.value = head.data() + colon + 2;
+        header.value_len = eol - colon - 2;
+        resp->add_header(&header);
+        pos = eol + 2;
+    }
+}
+
+void append_size(std::string &out, size_t n)
+{
+    char buf[20];
+    char *p = buf + sizeof buf;
+    do
+    {
+        *--p = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n);
+    out.append(p, buf + sizeof buf - p);
+}
+
+}  // namespace
+
 HttpServerTask::HttpServerTask(CommService *service,
                                ProcFunc& process) :
         WFServerTask(service, WFGlobal::get_scheduler(), process),
@@ -30,21 +84,26 @@ void HttpServerTask::handle(int state, int error)
 {
     if (state == WFT_STATE_TOREPLY)
     {
+        this->req.fill_header_map();    // before the process function runs
         req_is_alive_ = this->req.is_keep_alive();
         if (req_is_alive_ && this->req.has_keep_alive_header())
         {
-            HttpHeaderCursor req_cursor(&this->req);
-            struct HttpMessageHeader header{};
-
-            header.name = "Keep-Alive";
-            header.name_len = strlen("Keep-Alive");
-            req_has_keep_alive_header_ = req_cursor.find(&header);
+            StringPiece keep_alive = this->req.header(HEADER_KEEP_ALIVE);
+            req_has_keep_alive_header_ = keep_alive.data() != nullptr;
             if (req_has_keep_alive_header_)
             {
-                req_keep_alive_.assign((const char *) header.value,
-                                       header.value_len);
+                req_keep_alive_.assign(keep_alive.data(), keep_alive.size());
             }
         }
+    } else if (this->state != WFT_STATE_TOREPLY &&
+               this->req.release_later([this, state, error]()
+               {
+                   this->WFServerTask::handle(state, error);
+               }))
+    {
+        // the request never made it whole, WFServerTask deletes the task
+        // once the body consumer is done with it
+        return;
     }
     this->WFServerTask::handle(state, error);
 }
@@ -53,38 +112,29 @@ void HttpServerTask::handle(int state, int error)
 CommMessageOut *HttpServerTask::message_out()
 {
     HttpResp *resp = this->get_resp();
+    RespHeaders &fields = resp->header_fields_;
 
-    std::map<std::string, std::string, MapStringCaseLess> &headers = resp->headers;
-    // content type
-    if(headers.find("Content-Type") == headers.end())
-    {
-        headers["Content-Type"] = "text/plain";
-    }
-    if(headers.find("Date") == headers.end())
-    {
-        headers["Date"] = Timestamp::now().to_format_str("%a, %d %b %Y %H:%M:%S GMT");
-    }
-    struct HttpMessageHeader header;
+    // resp->headers wins over the fields, it lives as long as they do
+    for (auto &header_kv : resp->headers)
+        fields.set_static(header_kv.first, header_kv.second);
 
-    // fill headers we set
-    for(auto &header_kv : headers)
+    // Headers the protocol message has already, e.g. the ones of a proxied
+    // response. None for anything else.
+    unsigned in_message = 0;    // 1 << id
     {
-        header.name = header_kv.first.c_str();
-        header.name_len = header_kv.first.size();
-        header.value = header_kv.second.c_str();
-        header.value_len = header_kv.second.size();
-        resp->add_header(&header);
-    }
-    // fill cookie
-    for(auto &cookie : resp->cookies())
-    {
-        std::string cookie_str = cookie.dump();
-        header.name = "Set-Cookie";
-        header.name_len = 10;
-        header.value = cookie_str.c_str();
-        header.value_len = cookie_str.size();
-        resp->add_header(&header);
+        HttpHeaderCursor cursor(resp);
+        struct HttpMessageHeader header;
+        while (cursor.next(header))
+        {
+            enum http_header_id id = KnownHeader::to_enum(StringPiece(header.name, header.name_len));
+            if (id != HEADER_UNKNOWN)
+                in_message |= 1u << id;
+        }
     }
+    auto has = [&fields, in_message](enum http_header_id id)
+    {
+        return fields.has(id) || (in_message & (1u << id));
+    };
 
     if (!resp->get_http_version())
         resp->set_http_version("HTTP/1.1");
@@ -101,21 +151,15 @@ CommMessageOut *HttpServerTask::message_out()
 
         HttpUtil::set_response_status(resp, status_code);
     }
-    
-    if (!resp->is_chunked() && !resp->has_content_length_header())
-    {
-        char buf[32];
-        header.name = "Content-Length";
-        header.name_len = strlen("Content-Length");
-        header.value = buf;
-        header.value_len = sprintf(buf, "%zu", resp->get_output_body_size());
-        resp->add_header(&header);
-    }
 
     bool is_alive;
 
+    const RespHeaders::Field *connection = fields.find(HEADER_CONNECTION);
     if (resp->has_connection_header())
         is_alive = resp->is_keep_alive();
+    else if (connection)
+        is_alive = !(connection->value.size() == 5 &&
+                     strncasecmp(connection->value.data(), "close", 5) == 0);
     else
         is_alive = req_is_alive_;
 
@@ -167,22 +211,47 @@ CommMessageOut *HttpServerTask::message_out()
 
     }
 
-    if (!resp->has_connection_header())
+    // all of it in one go, encode() sends it as a single iovec
+    std::string *head = &head_scratch();
+    fields.serialize(*head);
+    if (!has(HEADER_CONTENT_TYPE))
+        head->append("Content-Type: text/plain\r\n");
+    if (!has(HEADER_DATE))
+    {
+        char date[HttpDate::k_date_len];
+        HttpDate::now(date);
+        head->append("Date: ").append(date, HttpDate::k_date_len).append("\r\n");
+    }
+    for (auto &cookie : resp->cookies())
+    {
+        head->append("Set-Cookie: ");
+        cookie.dump(*head);
+        head->append("\r\n");
+    }
+    if (!resp->is_chunked() && !has(HEADER_CONTENT_LENGTH) &&
+        !fields.find("Transfer-Encoding"))
+    {
+        head->append("Content-Length: ");
+        append_size(*head, resp->get_output_body_size());
+        head->append("\r\n");
+    }
+    if (!resp->has_connection_header() && !connection)
     {
-        header.name = "Connection";
-        header.name_len = 10;
         if (this->keep_alive_timeo == 0)
-        {
-            header.value = "close";
-            header.value_len = 5;
-        } else
-        {
-            header.value = "Keep-Alive";
-            header.value_len = 10;
-        }
-
-        resp->add_header(&header);
+            head->append("Connection: close\r\n");
+        else
+            head->append("Connection: Keep-Alive\r\n");
+    }
+    if (HttpResp::head_splice_works())
+    {
+        char *p = static_cast<char *>(resp->arena_->allocate(head->size(), 1));
+        memcpy(p, head->data(), head->size());
+        resp->head_ = StringPiece(p, head->size());
+    } else
+    {
+        add_head_fields(resp, *head);
     }
+
     return this->WFServerTask::message_out();
 }
 
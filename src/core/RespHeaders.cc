@@ -0,0 +1,124 @@
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+#include "RespHeaders.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+inline bool same_name(const StringPiece &lhs, const StringPiece &rhs)
+{
+    return lhs.size() == rhs.size() &&
+           strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+}  // namespace
+
+StringPiece RespHeaders::copy(const StringPiece &str)
+{
+    if (str.size() == 0)
+        return StringPiece("", 0);
+
+    char *buf = static_cast<char *>(arena_->allocate(str.size(), 1));
+    memcpy(buf, str.data(), str.size());
+    return StringPiece(buf, str.size());
+}
+
+void RespHeaders::add_static(const StringPiece &name, const StringPiece &value)
+{
+    fields_.push_back(Field{name, value});
+    enum http_header_id id = KnownHeader::to_enum(name);
+    if (id != HEADER_UNKNOWN)
+        known_set_ |= 1u << id;
+}
+
+void RespHeaders::set_static(const StringPiece &name, const StringPiece &value)
+{
+    this->set_field(name, value);
+    enum http_header_id id = KnownHeader::to_enum(name);
+    if (id != HEADER_UNKNOWN)
+        known_set_ |= 1u << id;
+}
+
+void RespHeaders::set_static(enum http_header_id id, const StringPiece &value)
+{
+    this->set_field(KnownHeader::to_str(id), value);
+    known_set_ |= 1u << id;
+}
+
+// keeps the place of the first one
+void RespHeaders::set_field(const StringPiece &name, const StringPiece &value)
+{
+    auto first = std::find_if(fields_.begin(), fields_.end(), [&name](const Field &field)
+    {
+        return same_name(field.name, name);
+    });
+    if (first == fields_.end())
+    {
+        fields_.push_back(Field{name, value});
+        return;
+    }
+    first->value = value;
+    fields_.erase(std::remove_if(first + 1, fields_.end(), [&name](const Field &field)
+    {
+        return same_name(field.name, name);
+    }), fields_.end());
+}
+
+bool RespHeaders::erase(const StringPiece &name)
+{
+    size_t size = fields_.size();
+    fields_.erase(std::remove_if(fields_.begin(), fields_.end(), [&name](const Field &field)
+    {
+        return same_name(field.name, name);
+    }), fields_.end());
+    if (fields_.size() == size)
+        return false;
+
+    enum http_header_id id = KnownHeader::to_enum(name);
+    if (id != HEADER_UNKNOWN)
+        known_set_ &= ~(1u << id);
+    return true;
+}
+
+const RespHeaders::Field *RespHeaders::find(const StringPiece &name) const
+{
+    for (const Field &field : fields_)
+    {
+        if (same_name(field.name, name))
+            return &field;
+    }
+    return nullptr;
+}
+
+size_t RespHeaders::serialized_size() const
+{
+    size_t size = 0;
+    for (const Field &field : fields_)
+        size += field.name.size() + 2 + field.value.size() + 2;
+    return size;
+}
+
+void RespHeaders::serialize(std::string &out) const
+{
+    size_t pos = out.size();
+    out.resize(pos + this->serialized_size());
+    char *p = &out[pos];
+    for (const Field &field : fields_)
+    {
+        memcpy(p, field.name.data(), field.name.size());
+        p += field.name.size();
+        *p++ = ':';
+        *p++ = ' ';
+        if (field.value.size() > 0)
+        {
+            memcpy(p, field.value.data(), field.value.size());
+            p += field.value.size();
+        }
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+}
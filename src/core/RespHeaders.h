@@ -0,0 +1,102 @@
+#ifndef WFREST_RESPHEADERS_H_
+#define WFREST_RESPHEADERS_H_
+
+#include <string>
+#include "StringPiece.h"
+#include "HttpDef.h"
+#include "Arena.h"
+
+namespace wfrest
+{
+
+// The headers of a response, in the order they were set.
+// add() and set() copy name and value into the arena of the response,
+// the _static ones keep the pointers, for literals and anything else that
+// outlives the response. Nothing goes through the protocol message :
+// HttpServerTask writes them all as one block, see HttpResp::encode().
+class RespHeaders
+{
+public:
+    struct Field
+    {
+        StringPiece name;
+        StringPiece value;
+    };
+
+    using const_iterator = ArenaVector<Field>::const_iterator;
+
+    // room for this many before fields_ grows
+    static const size_t k_reserve = 8;
+
+    explicit RespHeaders(Arena *arena)
+        : arena_(arena), fields_(ArenaAllocator<Field>(arena))
+    { fields_.reserve(k_reserve); }
+
+    // another field of the same name stays, e.g. Link or Vary
+    void add(const StringPiece &name, const StringPiece &value)
+    { this->add_static(copy(name), copy(value)); }
+
+    void add_static(const StringPiece &name, const StringPiece &value);
+
+    // the first field of that name gets the value, the others go
+    void set(const StringPiece &name, const StringPiece &value)
+    { this->set_static(copy(name), copy(value)); }
+
+    void set_static(const StringPiece &name, const StringPiece &value);
+
+    // HTTP_KNOWN_HEADER_MAP names are static already
+    void set(enum http_header_id id, const StringPiece &value)
+    { this->set_static(id, copy(value)); }
+
+    void set_static(enum http_header_id id, const StringPiece &value);
+
+    // all the fields of that name, false if there was none
+    bool erase(const StringPiece &name);
+
+    // case insensitive, the first one, nullptr if missing
+    const Field *find(const StringPiece &name) const;
+
+    const Field *find(enum http_header_id id) const
+    { return this->has(id) ? this->find(KnownHeader::to_str(id)) : nullptr; }
+
+    bool has(enum http_header_id id) const
+    { return known_set_ & (1u << id); }
+
+    // "name: value\r\n" for each field, appended to out
+    void serialize(std::string &out) const;
+
+    // what serialize() appends
+    size_t serialized_size() const;
+
+    const_iterator begin() const
+    { return fields_.begin(); }
+
+    const_iterator end() const
+    { return fields_.end(); }
+
+    size_t size() const
+    { return fields_.size(); }
+
+    bool empty() const
+    { return fields_.empty(); }
+
+    void clear()
+    {
+        fields_.clear();
+        known_set_ = 0;
+    }
+
+private:
+    StringPiece copy(const StringPiece &str);
+
+    void set_field(const StringPiece &name, const StringPiece &value);
+
+private:
+    Arena *arena_;
+    ArenaVector<Field> fields_;
+    unsigned known_set_ = 0;    // 1 << id of the known headers in fields_
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_RESPHEADERS_H_
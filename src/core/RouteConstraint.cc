@@ -0,0 +1,515 @@
+#include <cstring>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "RouteConstraint.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+const int k_max_repeat = 64;
+const size_t k_max_nfa_states = 4096;
+const size_t k_max_dfa_states = 1024;
+
+using ByteSet = std::bitset<256>;
+
+struct Ast
+{
+    enum Type { CHARSET, CONCAT, ALT, REPEAT };
+
+    Type type;
+    int set;        // CHARSET : index of its ByteSet
+    int min;        // REPEAT
+    int max;        // REPEAT : -1 for unbounded
+    std::vector<std::unique_ptr<Ast>> children;
+
+    explicit Ast(Type t) : type(t), set(-1), min(0), max(0) {}
+};
+
+// Recursive descent over the regex subset, builds an Ast and the ByteSets.
+class Parser
+{
+public:
+    Parser(const StringPiece &re, std::vector<ByteSet> &sets)
+        : re_(re), pos_(0), sets_(sets), ok_(true)
+    {}
+
+    std::unique_ptr<Ast> parse()
+    {
+        std::unique_ptr<Ast> ast = parse_alt();
+        if (pos_ != re_.size())
+            ok_ = false;
+        return ok_ ? std::move(ast) : nullptr;
+    }
+
+private:
+    bool more() const
+    { return pos_ < re_.size(); }
+
+    char peek() const
+    { return re_[pos_]; }
+
+    std::unique_ptr<Ast> parse_alt()
+    {
+        std::unique_ptr<Ast> alt(new Ast(Ast::ALT));
+        alt->children.push_back(parse_concat());
+        while (ok_ && more() && peek() == '|')
+        {
+            pos_++;
+            alt->children.push_back(parse_concat());
+        }
+        return alt;
+    }
+
+    std::unique_ptr<Ast> parse_concat()
+    {
+        std::unique_ptr<Ast> concat(new Ast(Ast::CONCAT));
+        while (ok_ && more() && peek() != '|' && peek() != ')')
+            concat->children.push_back(parse_repeat());
+        return concat;
+    }
+
+    std::unique_ptr<Ast> parse_repeat()
+    {
+        std::unique_ptr<Ast> atom = parse_atom();
+        while (ok_ && more())
+        {
+            int min, max;
+            char c = peek();
+            if (c == '*')
+            {
+                min = 0;
+                max = -1;
+                pos_++;
+            } else if (c == '+')
+            {
+                min = 1;
+                max = -1;
+                pos_++;
+            } else if (c == '?')
+            {
+                min = 0;
+                max = 1;
+                pos_++;
+            } else if (c == '{')
+            {
+                if (!parse_bounds(min, max))
+                    return nullptr;
+            } else
+            {
+                break;
+            }
+            std::unique_ptr<Ast> repeat(new Ast(Ast::REPEAT));
+            repeat->min = min;
+            repeat->max = max;
+            repeat->children.push_back(std::move(atom));
+            atom = std::move(repeat);
+        }
+        return atom;
+    }
+
+    // {m} {m,} {m,n}
+    bool parse_bounds(int &min, int &max)
+    {
+        pos_++;
+        if (!parse_int(min))
+            return ok_ = false;
+        max = min;
+        if (more() && peek() == ',')
+        {
+            pos_++;
+            max = -1;
+            if (more() && peek() != '}' && !parse_int(max))
+                return ok_ = false;
+        }
+        if (!more() || peek() != '}' || (max != -1 && max < min))
+            return ok_ = false;
+        pos_++;
+        return true;
+    }
+
+    bool parse_int(int &val)
+    {
+        size_t begin = pos_;
+        val = 0;
+        while (more() && peek() >= '0' && peek() <= '9' && val <= k_max_repeat)
+            val = val * 10 + (re_[pos_++] - '0');
+        return pos_ != begin && val <= k_max_repeat;
+    }
+
+    std::unique_ptr<Ast> parse_atom()
+    {
+        if (!more())
+        {
+            ok_ = false;
+            return nullptr;
+        }
+        char c = re_[pos_++];
+        if (c == '(')
+        {
+            std::unique_ptr<Ast> alt = parse_alt();
+            if (!more() || peek() != ')')
+            {
+                ok_ = false;
+                return nullptr;
+            }
+            pos_++;
+            return alt;
+        }
+
+        ByteSet set;
+        if (c == '[')
+        {
+            if (!parse_class(set))
+                return nullptr;
+        } else if (c == '.')
+        {
+            set.set();
+        } else if (c == '\\')
+        {
+            if (!parse_escape(set))
+                return nullptr;
+        } else if (c == '*' || c == '+' || c == '?' || c == '{' || c == '}' || c == ']')
+        {
+            ok_ = false;
+            return nullptr;
+        } else
+        {
+            set.set(static_cast<unsigned char>(c));
+        }
+        // a segment never contains '/'
+        set.reset('/');
+
+        std::unique_ptr<Ast> atom(new Ast(Ast::CHARSET));
+        atom->set = static_cast<int>(sets_.size());
+        sets_.push_back(set);
+        return atom;
+    }
+
+    bool parse_escape(ByteSet &set)
+    {
+        if (!more())
+            return ok_ = false;
+        char c = re_[pos_++];
+        if (c == 'd')
+        {
+            for (int b = '0'; b <= '9'; b++) set.set(b);
+        } else if (c == 'w')
+        {
+            for (int b = '0'; b <= '9'; b++) set.set(b);
+            for (int b = 'a'; b <= 'z'; b++) set.set(b);
+            for (int b = 'A'; b <= 'Z'; b++) set.set(b);
+            set.set('_');
+        } else
+        {
+            set.set(static_cast<unsigned char>(c));
+        }
+        return true;
+    }
+
+    // after '[' : [^a-z0-9_-]
+    bool parse_class(ByteSet &set)
+    {
+        bool negate = more() && peek() == '^';
+        if (negate)
+            pos_++;
+        bool first = true;
+        while (more() && (peek() != ']' || first))
+        {
+            first = false;
+            unsigned char lo = re_[pos_++];
+            if (lo == '\\')
+            {
+                ByteSet esc;
+                if (!parse_escape(esc))
+                    return false;
+                set |= esc;
+                continue;
+            }
+            // a-z, a '-' first or last is a literal
+            if (pos_ + 1 < re_.size() && peek() == '-' && re_[pos_ + 1] != ']')
+            {
+                unsigned char hi = re_[pos_ + 1];
+                pos_ += 2;
+                if (hi < lo)
+                    return ok_ = false;
+                for (int b = lo; b <= hi; b++) set.set(b);
+            } else
+            {
+                set.set(lo);
+            }
+        }
+        if (!more())
+            return ok_ = false;
+        pos_++;     // ]
+        if (negate)
+            set.flip();
+        return true;
+    }
+
+private:
+    StringPiece re_;
+    size_t pos_;
+    std::vector<ByteSet> &sets_;
+    bool ok_;
+};
+
+// Thompson NFA : a state has either epsilon edges or one ByteSet edge
+struct Nfa
+{
+    struct State
+    {
+        std::vector<int> eps;
+        int set = -1;
+        int next = -1;
+    };
+
+    struct Frag
+    {
+        int start;
+        int end;
+    };
+
+    std::vector<State> states;
+    bool overflow = false;
+
+    int add()
+    {
+        if (states.size() >= k_max_nfa_states)
+            overflow = true;
+        states.push_back(State());
+        return static_cast<int>(states.size() - 1);
+    }
+
+    Frag build(const Ast *ast)
+    {
+        if (overflow)
+            return Frag{0, 0};
+        switch (ast->type)
+        {
+        case Ast::CHARSET:
+        {
+            int s = add();
+            int e = add();
+            states[s].set = ast->set;
+            states[s].next = e;
+            return Frag{s, e};
+        }
+        case Ast::CONCAT:
+        {
+            int s = add();
+            int cur = s;
+            for (auto &child : ast->children)
+            {
+                Frag f = build(child.get());
+                states[cur].eps.push_back(f.start);
+                cur = f.end;
+            }
+            return Frag{s, cur};
+        }
+        case Ast::ALT:
+        {
+            int s = add();
+            int e = add();
+            for (auto &child : ast->children)
+            {
+                Frag f = build(child.get());
+                states[s].eps.push_back(f.start);
+                states[f.end].eps.push_back(e);
+            }
+            return Frag{s, e};
+        }
+        case Ast::REPEAT:
+        default:
+        {
+            const Ast *child = ast->children[0].get();
+            int s = add();
+            int cur = s;
+            for (int i = 0; i < ast->min; i++)
+            {
+                Frag f = build(child);
+                states[cur].eps.push_back(f.start);
+                cur = f.end;
+            }
+            int e = add();
+            if (ast->max == -1)
+            {
+                int loop = add();
+                Frag f = build(child);
+                states[cur].eps.push_back(loop);
+                states[loop].eps.push_back(f.start);
+                states[loop].eps.push_back(e);
+                states[f.end].eps.push_back(loop);
+            } else
+            {
+                for (int i = ast->min; i < ast->max; i++)
+                {
+                    Frag f = build(child);
+                    states[cur].eps.push_back(f.start);
+                    states[cur].eps.push_back(e);
+                    cur = f.end;
+                }
+                states[cur].eps.push_back(e);
+            }
+            return Frag{s, e};
+        }
+        }
+    }
+
+    void closure(std::vector<int> &set) const
+    {
+        std::vector<bool> seen(states.size());
+        std::vector<int> stack(set);
+        set.clear();
+        while (!stack.empty())
+        {
+            int s = stack.back();
+            stack.pop_back();
+            if (seen[s])
+                continue;
+            seen[s] = true;
+            set.push_back(s);
+            for (int e : states[s].eps)
+                stack.push_back(e);
+        }
+        std::sort(set.begin(), set.end());
+    }
+};
+
+const char *builtin_regex(const StringPiece &spec)
+{
+    if (spec == StringPiece("int"))
+        return "-?[0-9]+";
+    if (spec == StringPiece("uint"))
+        return "[0-9]+";
+    if (spec == StringPiece("hex"))
+        return "[0-9a-fA-F]+";
+    if (spec == StringPiece("alpha"))
+        return "[a-zA-Z]+";
+    if (spec == StringPiece("alnum"))
+        return "[a-zA-Z0-9]+";
+    if (spec == StringPiece("uuid"))
+        return "[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}";
+    return nullptr;
+}
+
+}  // namespace
+
+const uint32_t RouteConstraint::k_dead;
+
+void RouteConstraint::split_param(const StringPiece &key,
+                                  OUT StringPiece &name, OUT StringPiece &spec)
+{
+    // strip { }
+    StringPiece inner(key.data() + 1, key.size() - 2);
+    spec.clear();
+    size_t colon = 0;
+    while (colon < inner.size() && inner[colon] != ':')
+        colon++;
+    if (colon < inner.size())
+    {
+        spec.set(inner.data() + colon + 1, inner.size() - colon - 1);
+        inner.remove_suffix(inner.size() - colon);
+    }
+    while (!inner.empty() && inner[0] == ' ')
+        inner.remove_prefix(1);
+    while (!inner.empty() && inner[inner.size() - 1] == ' ')
+        inner.remove_suffix(1);
+    name = inner;
+}
+
+bool RouteConstraint::compile(const StringPiece &spec)
+{
+    // matches nothing until compiled
+    memset(byte_class_, 0, sizeof byte_class_);
+    class_count_ = 1;
+    start_ = k_dead;
+    next_.assign(1, k_dead);
+    accept_.assign(1, 0);
+
+    const char *builtin = builtin_regex(spec);
+    StringPiece re = builtin ? StringPiece(builtin) : spec;
+    if (re.empty())
+        return false;
+
+    std::vector<ByteSet> sets;
+    std::unique_ptr<Ast> ast = Parser(re, sets).parse();
+    if (!ast)
+        return false;
+
+    Nfa nfa;
+    Nfa::Frag frag = nfa.build(ast.get());
+    if (nfa.overflow)
+        return false;
+
+    // bytes in exactly the same sets behave the same, give them one class
+    std::map<std::vector<bool>, uint8_t> signatures;
+    std::vector<int> class_byte;    // a byte of each class
+    for (int b = 0; b < 256; b++)
+    {
+        std::vector<bool> sig(sets.size());
+        for (size_t i = 0; i < sets.size(); i++)
+            sig[i] = sets[i].test(b);
+        auto it = signatures.find(sig);
+        if (it == signatures.end())
+        {
+            it = signatures.emplace(sig, static_cast<uint8_t>(class_byte.size())).first;
+            class_byte.push_back(b);
+        }
+        byte_class_[b] = it->second;
+    }
+    uint16_t class_count = static_cast<uint16_t>(class_byte.size());
+
+    // subset construction, DFA state 0 is the dead state
+    std::map<std::vector<int>, uint16_t> ids;
+    std::vector<std::vector<int>> subsets(1);
+    std::vector<uint32_t> next(class_count, k_dead);
+    std::vector<uint8_t> accept(1, 0);
+
+    std::vector<int> init(1, frag.start);
+    nfa.closure(init);
+    ids[init] = 1;
+    subsets.push_back(init);
+    next.resize(2 * class_count, k_dead);
+    accept.push_back(std::binary_search(init.begin(), init.end(), frag.end));
+
+    for (size_t d = 1; d < subsets.size(); d++)
+    {
+        for (uint16_t c = 0; c < class_count; c++)
+        {
+            int b = class_byte[c];
+            std::vector<int> target;
+            for (int s : subsets[d])
+            {
+                const Nfa::State &st = nfa.states[s];
+                if (st.set >= 0 && sets[st.set].test(b))
+                    target.push_back(st.next);
+            }
+            if (target.empty())
+                continue;
+            nfa.closure(target);
+
+            auto it = ids.find(target);
+            if (it == ids.end())
+            {
+                if (subsets.size() >= k_max_dfa_states)
+                    return false;
+                uint16_t id = static_cast<uint16_t>(subsets.size());
+                it = ids.emplace(target, id).first;
+                subsets.push_back(target);
+                next.resize(subsets.size() * class_count, k_dead);
+                accept.push_back(std::binary_search(target.begin(), target.end(), frag.end));
+            }
+            next[d * class_count + c] = static_cast<uint32_t>(it->second) * class_count;
+        }
+    }
+
+    class_count_ = class_count;
+    start_ = class_count;
+    next_.swap(next);
+    accept_.swap(accept);
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef WFREST_ROUTECONSTRAINT_H_
+#define WFREST_ROUTECONSTRAINT_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "StringPiece.h"
+#include "Macro.h"
+#include "Noncopyable.h"
+
+namespace wfrest
+{
+
+// Constraint of a {name:spec} route segment, compiled into a DFA that
+// must accept the whole segment.
+//
+// spec is one of
+//   int, uint, hex, alpha, alnum, uuid
+// or a regex made of literals, ., [a-z0-9_-] / [^...] classes, \d \w,
+// ( ), |, and the * + ? {m} {m,} {m,n} quantifiers.
+//
+// Bytes that no part of the regex tells apart share a column of the
+// transition table, so a DFA is a few hundred bytes.
+class RouteConstraint : public Noncopyable
+{
+public:
+    // false if spec is not understood, the constraint then matches nothing
+    bool compile(const StringPiece &spec);
+
+    bool match(const StringPiece &segment) const
+    {
+        uint32_t row = start_;
+        for (size_t i = 0; i < segment.size(); i++)
+        {
+            row = next_[row + byte_class_[static_cast<unsigned char>(segment[i])]];
+            if (row == k_dead)
+                return false;
+        }
+        return accept_[row / class_count_] != 0;
+    }
+
+    size_t state_count() const
+    { return accept_.size(); }
+
+    // {name:spec} -> name, spec. {name} -> name, empty spec.
+    // Spaces around name are dropped.
+    static void split_param(const StringPiece &key,
+                            OUT StringPiece &name, OUT StringPiece &spec);
+
+private:
+    static const uint32_t k_dead = 0;
+
+    uint8_t byte_class_[256] = {0};
+    uint32_t class_count_ = 1;
+    uint32_t start_ = k_dead;
+    // [row + class] is the row of the next state, row = state * class_count_,
+    // so the loop above has no multiply
+    std::vector<uint32_t> next_ = std::vector<uint32_t>(1, k_dead);
+    std::vector<uint8_t> accept_ = std::vector<uint8_t>(1, 0);  // [state]
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_ROUTECONSTRAINT_H_
@@ -0,0 +1,104 @@
+#ifndef WFREST_ROUTEPARAMS_H_
+#define WFREST_ROUTEPARAMS_H_
+
+#include "StringPiece.h"
+#include "Arena.h"
+
+namespace wfrest
+{
+
+// name  : interned in the route table when the routes are registered
+// value : points into the request path
+struct RouteParam
+{
+    StringPiece name;
+    StringPiece value;
+};
+
+// {name} segments captured while matching a route.
+// The first k_inline_size params live inside the object, so routing
+// does not allocate for any reasonable route.
+class RouteParams
+{
+public:
+    static const size_t k_inline_size = 8;
+
+    RouteParams()
+    {}
+
+    // the ones past k_inline_size go to arena
+    explicit RouteParams(Arena *arena)
+        : overflow_(ArenaAllocator<RouteParam>(arena))
+    {}
+
+    void add(const StringPiece &name, const StringPiece &value)
+    {
+        if (size_ < k_inline_size)
+        {
+            inline_[size_].name = name;
+            inline_[size_].value = value;
+        } else
+        {
+            overflow_.push_back(RouteParam{name, value});
+        }
+        size_++;
+    }
+
+    // drop the params captured after size, when matching backtracks
+    void truncate(size_t size)
+    {
+        if (size >= size_)
+            return;
+        if (size_ > k_inline_size)
+            overflow_.resize(size > k_inline_size ? size - k_inline_size : 0);
+        size_ = size;
+    }
+
+    // the last capture wins if a name appears twice in a route
+    const RouteParam *find(const StringPiece &name) const
+    {
+        for (size_t i = size_; i > 0; i--)
+        {
+            const RouteParam &param = (*this)[i - 1];
+            if (param.name == name)
+                return &param;
+        }
+        return nullptr;
+    }
+
+    // the values in [from, from + len) now point at the same offset of to
+    void rebase(const char *from, size_t len, const char *to)
+    {
+        for (size_t i = 0; i < size_; i++)
+        {
+            RouteParam &param = i < k_inline_size ? inline_[i] : overflow_[i - k_inline_size];
+            const char *p = param.value.data();
+            if (p >= from && p <= from + len)
+                param.value.set(to + (p - from), param.value.size());
+        }
+    }
+
+    const RouteParam &operator[](size_t i) const
+    { return i < k_inline_size ? inline_[i] : overflow_[i - k_inline_size]; }
+
+    size_t size() const
+    { return size_; }
+
+    bool empty() const
+    { return size_ == 0; }
+
+    void clear()
+    {
+        size_ = 0;
+        overflow_.clear();
+    }
+
+private:
+    RouteParam inline_[k_inline_size];
+    size_t size_ = 0;
+    ArenaVector<RouteParam> overflow_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_ROUTEPARAMS_H_
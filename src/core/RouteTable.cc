@@ -1,4 +1,6 @@
 #include <queue>
+#include <cstdio>
+#include <cstdlib>
 #include "RouteTable.h"
 
 using namespace wfrest;
@@ -20,6 +22,9 @@ VerbHandler &RouteTableNode::find_or_create(const StringPiece &route, int cursor
     // store GET("/", ...)
     if(cursor == 0 && route.as_string() == "/")
     {
+        auto it = children_.find(route);
+        if (it != children_.end())
+            return it->second->find_or_create(route, ++cursor);
         auto *new_node = new RouteTableNode();
         children_.insert({route, new_node});
         return new_node->find_or_create(route, ++cursor);
@@ -39,20 +44,75 @@ VerbHandler &RouteTableNode::find_or_create(const StringPiece &route, int cursor
         return it->second->find_or_create(route, cursor);
     } else
     {
+        // {name:spec}, a spec not understood would 404 forever : a bug that
+        // should not get to serve, like a typed route that cannot match
+        std::unique_ptr<RouteConstraint> constraint;
+        if (mid.size() > 2 && mid[0] == '{' && mid[mid.size() - 1] == '}')
+        {
+            StringPiece name, spec;
+            RouteConstraint::split_param(mid, name, spec);
+            if (!spec.empty())
+            {
+                constraint.reset(new RouteConstraint);
+                if (!constraint->compile(spec))
+                {
+                    fprintf(stderr, "[WFREST] invalid constraint %s in %s\n",
+                            mid.as_string().c_str(), route.as_string().c_str());
+                    abort();
+                }
+            }
+        }
         auto *new_node = new RouteTableNode();
+        new_node->constraint_ = std::move(constraint);
         children_.insert({mid, new_node});
         return new_node->find_or_create(route, cursor);
     }
 }
 
+bool RouteTableNode::remove(const StringPiece &route, int cursor, Verb verb)
+{
+    if (cursor == route.size())
+    {
+        return verb_handler_.erase(verb);
+    }
+
+    // same walk as find_or_create
+    StringPiece mid;
+    if (cursor == 0 && route.as_string() == "/")
+    {
+        mid = route;
+        cursor++;
+    } else
+    {
+        if (route[cursor] == '/')
+            cursor++;
+        int anchor = cursor;
+        while (cursor < route.size() and route[cursor] != '/')
+            cursor++;
+        mid = StringPiece(route.begin() + anchor, cursor - anchor);
+    }
+
+    auto it = children_.find(mid);
+    if (it == children_.end() || !it->second->remove(route, cursor, verb))
+        return false;
+
+    RouteTableNode *child = it->second;
+    if (child->children_.empty() && child->verb_handler_.empty())
+    {
+        children_.erase(it);
+        delete child;
+    }
+    return true;
+}
+
 RouteTableNode::iterator RouteTableNode::find(const StringPiece &route,
                                         int cursor,
-                                        OUT std::map<std::string, std::string> &route_params,
-                                        OUT std::string &route_match_path) const
+                                        OUT RouteParams &route_params,
+                                        OUT StringPiece &route_match_path) const
 {
     assert(cursor >= 0);
     // We found the route
-    if ((cursor == route.size() and !verb_handler_.verb_handler_map.empty()) or (children_.empty()))
+    if ((cursor == route.size() and !verb_handler_.empty()) or (children_.empty()))
         return iterator{this, route, verb_handler_};
     // /*
     if(cursor == route.size() and !children_.empty())
@@ -60,14 +120,14 @@ RouteTableNode::iterator RouteTableNode::find(const StringPiece &route,
         auto it = children_.find(StringPiece("*"));
         if(it != children_.end())
         {
-            if(it->second->verb_handler_.verb_handler_map.empty())
+            if(it->second->verb_handler_.empty())
                 fprintf(stderr, "handler nullptr");
             return iterator{it->second, route, it->second->verb_handler_};
         }
     }
 
     // route does not match any.
-    if (cursor == route.size() and verb_handler_.verb_handler_map.empty())
+    if (cursor == route.size() and verb_handler_.empty())
         return iterator{nullptr, route, verb_handler_};
 
     // find GET("/", ...)
@@ -104,23 +164,28 @@ RouteTableNode::iterator RouteTableNode::find(const StringPiece &route,
     if (it != children_.end())
     {
         // it2 == RouteTableNode::iterator
+        size_t captured = route_params.size();
         auto it2 = it->second->find(route, cursor, route_params, route_match_path); // search in the corresponding child.
         if (it2 != it->second->end())
             return it2;
+        route_params.truncate(captured);
     }
 
-    // if one child is an url param {name}, choose it
+    // prefix* children before the first {param} in key order, then the
+    // {name:spec} children whose constraint accepts mid, then that {param}
+    const RouteTableNode *param_node = nullptr;
+    StringPiece param_name;
+    bool has_constraint = false;
     for (auto &kv: children_)
     {
         StringPiece param(kv.first);
-        if (!param.empty() && param[param.size() - 1] == '*')
+        if (!param_node && !param.empty() && param[param.size() - 1] == '*')
         {
             StringPiece match(param);
             match.remove_suffix(1);
             if (mid.starts_with(match))
             {
-                StringPiece match_path(route.data() + cursor);
-                route_match_path = mid.as_string() + match_path.as_string();
+                route_match_path.set(mid.data(), route.size() - anchor);
                 return iterator{kv.second, route, kv.second->verb_handler_};
             } 
         }
@@ -128,16 +193,41 @@ RouteTableNode::iterator RouteTableNode::find(const StringPiece &route,
         if (param.size() > 2 and param[0] == '{' and
             param[param.size() - 1] == '}')
         {
-            int i = 1;
-            int j = param.size() - 2;
-            while (param[i] == ' ') i++;
-            while (param[j] == ' ') j--;
-
-            param.shrink(i, param.size() - 1 - j);
-            route_params[param.as_string()] = mid.as_string();
-            return kv.second->find(route, cursor, route_params, route_match_path);
+            if (kv.second->constraint_)
+            {
+                has_constraint = true;
+            } else if (!param_node)
+            {
+                StringPiece spec;
+                RouteConstraint::split_param(param, param_name, spec);
+                param_node = kv.second;
+            }
+        }
+    }
+
+    if (has_constraint)
+    {
+        for (auto &kv: children_)
+        {
+            const RouteTableNode *child = kv.second;
+            if (!child->constraint_ || !child->constraint_->match(mid))
+                continue;
+            StringPiece name, spec;
+            RouteConstraint::split_param(kv.first, name, spec);
+            size_t captured = route_params.size();
+            route_params.add(name, mid);
+            auto it2 = child->find(route, cursor, route_params, route_match_path);
+            if (it2 != child->end())
+                return it2;
+            route_params.truncate(captured);
         }
     }
+
+    if (param_node)
+    {
+        route_params.add(param_name, mid);
+        return param_node->find(route, cursor, route_params, route_match_path);
+    }
     return end();
 }
 
@@ -179,6 +269,8 @@ VerbHandler &RouteTable::find_or_create(const char *route)
 {
     // Use pointer to prevent iterator invalidation
     // StringPiece is only a watcher, so we should store the string.
+    frozen_ = false;
+    generation_ = next_generation();
     StringPiece route_piece(route);
     auto it = string_pieces_.find(route_piece);
     if(it != string_pieces_.end())
@@ -192,6 +284,41 @@ VerbHandler &RouteTable::find_or_create(const char *route)
     return root_.find_or_create(route2, 0);
 }
 
+bool RouteTable::remove(const char *route, Verb verb)
+{
+    if (!root_.remove(StringPiece(route), 0, verb))
+        return false;
+    frozen_ = false;
+    generation_ = next_generation();
+    return true;
+}
+
+const VerbHandler *RouteTable::find(const StringPiece &route,
+                                    OUT RouteParams &route_params,
+                                    OUT StringPiece &route_match_path) const
+{
+    if (frozen_)
+        return trie_.find(route, route_params, route_match_path);
+
+    auto it = root_.find(route, 0, route_params, route_match_path);
+    if (it == root_.end())
+        return nullptr;
+    return &it.ptr->verb_handler();
+}
+
+void RouteTable::freeze()
+{
+    trie_.build(root_);
+    frozen_ = true;
+    generation_ = next_generation();
+}
+
+uint64_t RouteTable::next_generation()
+{
+    static std::atomic<uint64_t> generation{0};
+    return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 RouteTable::~RouteTable()
 {
     for(auto str : strings_)
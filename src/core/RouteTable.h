@@ -7,10 +7,14 @@
 #include <memory>
 #include <cassert>
 #include <unordered_map>
+#include <atomic>
+#include <cstdint>
 
 #include "StringPiece.h"
 #include "Macro.h"
 #include "VerbHandler.h"
+#include "RouteTrie.h"
+#include "RouteConstraint.h"
 
 namespace wfrest
 {
@@ -38,22 +42,36 @@ public:
 
     VerbHandler &find_or_create(const StringPiece &route, int cursor);
 
+    // false if the route has no handler for verb.
+    // Nodes left without handlers nor children are deleted.
+    bool remove(const StringPiece &route, int cursor, Verb verb);
+
     iterator end() const
     { return iterator{nullptr, StringPiece(), VerbHandler()}; }
 
     iterator find(const StringPiece &route,
                   int cursor,
-                  OUT std::map<std::string, std::string> &route_params,
-                  OUT std::string &route_match_path) const;
+                  OUT RouteParams &route_params,
+                  OUT StringPiece &route_match_path) const;
 
     template<typename Func>
     void all_routes(const Func &func, std::string prefix) const;
 
+    // every node a route was registered on, leaf or not
+    template<typename Func>
+    void for_each_verb_handler(const Func &func) const;
+
+    const VerbHandler &verb_handler() const
+    { return verb_handler_; }
+
     void bfs_transverse();  // for test
     
 private:
+    friend class RouteTrie;
+
     VerbHandler verb_handler_;      // 动词 处理
     std::map<StringPiece, RouteTableNode *> children_;  // 保存 路由信息
+    std::unique_ptr<RouteConstraint> constraint_;       // for a {name:spec} node
 };
 
 template<typename Func>
@@ -74,6 +92,15 @@ void RouteTableNode::all_routes(const Func &func, std::string prefix) const
     }
 }
 
+template<typename Func>
+void RouteTableNode::for_each_verb_handler(const Func &func) const
+{
+    if (!verb_handler_.empty())
+        func(verb_handler_);
+    for (auto &pair: children_)
+        pair.second->for_each_verb_handler(func);
+}
+
 class RouteTable : public Noncopyable
 { 
 public:
@@ -81,22 +108,47 @@ public:
     // 找到 路由 并返回 对该路由的引用
     VerbHandler &find_or_create(const char *route);
 
-    RouteTableNode::iterator find(const StringPiece &route, 
-                                OUT std::map<std::string, std::string> &route_params,
-                                OUT std::string &route_match_path) const
-    { return root_.find(route, 0, route_params, route_match_path); }
+    // false if route has no handler for verb
+    bool remove(const char *route, Verb verb);
+
+    // nullptr if not found
+    const VerbHandler *find(const StringPiece &route, 
+                            OUT RouteParams &route_params,
+                            OUT StringPiece &route_match_path) const;
+
+    // Parameter-free routes only, nullptr if not found or not frozen
+    const VerbHandler *find_exact(const StringPiece &route) const
+    { return frozen_ ? trie_.find_exact(route) : nullptr; }
+
+    // Compile the registered routes into the flat trie.
+    // Routes added afterwards fall back to the tree walk until the next freeze.
+    void freeze();
+
+    bool frozen() const
+    { return frozen_; }
+
+    // Changes whenever the table or its trie changes, and is never
+    // reused by another table, so it can key caches of lookup results.
+    uint64_t generation() const
+    { return generation_; }
 
     template<typename Func>
     void all_routes(const Func &func) const
     { root_.all_routes(func, ""); }
 
-    RouteTableNode::iterator end() const
-    { return root_.end(); }
+    template<typename Func>
+    void for_each_verb_handler(const Func &func) const
+    { root_.for_each_verb_handler(func); }
 
     ~RouteTable();
     
 private:
+    static uint64_t next_generation();
+
     RouteTableNode root_;                   // 路由节点
+    RouteTrie trie_;                        // read-only copy of root_ for lookup
+    bool frozen_ = false;
+    uint64_t generation_ = next_generation();
     std::set<StringPiece> string_pieces_;  // check if exists
     std::vector<std::string *> strings_;  // for store ：路由存储
 };
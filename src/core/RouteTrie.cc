@@ -0,0 +1,336 @@
+#include <algorithm>
+#include "RouteTrie.h"
+#include "RouteTable.h"
+#include "RouteConstraint.h"
+
+using namespace wfrest;
+
+namespace
+{
+
+inline bool is_wildcard_key(const StringPiece &key)
+{
+    return !key.empty() && key[key.size() - 1] == '*';
+}
+
+inline bool is_param_key(const StringPiece &key)
+{
+    return key.size() > 2 && key[0] == '{' && key[key.size() - 1] == '}';
+}
+
+inline bool is_static_key(const StringPiece &key)
+{
+    return !is_wildcard_key(key) && !is_param_key(key);
+}
+
+}  // namespace
+
+void RouteTrie::build(const RouteTableNode &root)
+{
+    nodes_.clear();
+    static_edges_.clear();
+    wildcard_edges_.clear();
+    param_edges_.clear();
+    labels_.clear();
+    slash_node_ = k_npos;
+    exact_slots_.clear();
+    exact_mask_ = 0;
+    exact_count_ = 0;
+
+    build_node(&root);
+
+    // GET("/", ...) is stored as the "/" child of the root
+    auto it = root.children_.find(StringPiece("/"));
+    if (it != root.children_.end())
+        slash_node_ = build_node(it->second);
+
+    build_exact();
+}
+
+// The key of a node is the path the trie walk consumes to reach it through
+// static edges only, so an exact hit always agrees with find().
+void RouteTrie::collect_exact(int32_t idx, std::string &path,
+                              OUT std::vector<std::pair<std::string, const VerbHandler *>> &routes) const
+{
+    const Node &node = nodes_[idx];
+    if (node.has_handler && !path.empty())
+        routes.emplace_back(path, node.handler);
+
+    for (uint32_t i = node.static_begin; i < node.static_end; i++)
+    {
+        const Edge &edge = static_edges_[i];
+        size_t len = path.size();
+        path += '/';
+        path.append(labels_.data() + edge.label_off, edge.label_len);
+        collect_exact(edge.child, path, routes);
+        path.resize(len);
+    }
+}
+
+void RouteTrie::build_exact()
+{
+    std::vector<std::pair<std::string, const VerbHandler *>> routes;
+    // first inserted wins a duplicate key, and "/" shadows the "" child in find()
+    if (slash_node_ != k_npos && nodes_[slash_node_].has_handler)
+        routes.emplace_back("/", nodes_[slash_node_].handler);
+    std::string path;
+    collect_exact(0, path, routes);
+
+    exact_slots_.clear();
+    exact_count_ = routes.size();
+    if (routes.empty())
+    {
+        exact_mask_ = 0;
+        return;
+    }
+
+    // load factor <= 0.5
+    size_t capacity = 8;
+    while (capacity < routes.size() * 2)
+        capacity <<= 1;
+    exact_mask_ = capacity - 1;
+
+    ExactSlot empty_slot = {nullptr, 0, 0, 0};
+    exact_slots_.assign(capacity, empty_slot);
+    for (auto &route : routes)
+    {
+        size_t hash = StringPieceHash()(StringPiece(route.first));
+        size_t i = hash & exact_mask_;
+        while (exact_slots_[i].handler)
+            i = (i + 1) & exact_mask_;
+
+        ExactSlot &slot = exact_slots_[i];
+        slot.handler = route.second;
+        slot.hash = hash;
+        slot.key_off = add_label(route.first);
+        slot.key_len = static_cast<uint32_t>(route.first.size());
+    }
+}
+
+const VerbHandler *RouteTrie::find_exact(const StringPiece &route) const
+{
+    if (exact_slots_.empty())
+        return nullptr;
+
+    size_t hash = StringPieceHash()(route);
+    for (size_t i = hash & exact_mask_; ; i = (i + 1) & exact_mask_)
+    {
+        const ExactSlot &slot = exact_slots_[i];
+        if (!slot.handler)
+            return nullptr;
+        if (slot.hash == hash && slot.key_len == route.size() &&
+            memcmp(labels_.data() + slot.key_off, route.data(), route.size()) == 0)
+            return slot.handler;
+    }
+}
+
+uint32_t RouteTrie::add_label(const StringPiece &label)
+{
+    uint32_t off = static_cast<uint32_t>(labels_.size());
+    labels_.append(label.data(), label.size());
+    return off;
+}
+
+int32_t RouteTrie::build_node(const RouteTableNode *node)
+{
+    int32_t idx = static_cast<int32_t>(nodes_.size());
+    nodes_.push_back(Node());
+
+    std::vector<Edge> statics;
+    std::vector<Edge> wildcards;
+    std::vector<ParamEdge> params;
+    int32_t star_child = k_npos;
+    int32_t param_child = k_npos;
+    StringPiece param_name;
+
+    // children_ is ordered, so edges come out sorted by their first segment
+    for (auto &kv : node->children_)
+    {
+        const StringPiece &key = kv.first;
+        if (key == StringPiece("/"))
+            continue;
+
+        if (is_static_key(key))
+        {
+            // merge the chain of handler-less single static children
+            std::string label = key.as_string();
+            const RouteTableNode *cur = kv.second;
+            while (cur->verb_handler_.empty() &&
+                   cur->children_.size() == 1 &&
+                   is_static_key(cur->children_.begin()->first))
+            {
+                label += '/';
+                label += cur->children_.begin()->first.as_string();
+                cur = cur->children_.begin()->second;
+            }
+            Edge edge;
+            edge.label_off = add_label(label);
+            edge.label_len = static_cast<uint32_t>(label.size());
+            edge.first_len = static_cast<uint32_t>(key.size());
+            edge.child = build_node(cur);
+            statics.push_back(edge);
+            continue;
+        }
+
+        if (is_param_key(key) && kv.second->constraint_)
+        {
+            StringPiece name, spec;
+            RouteConstraint::split_param(key, name, spec);
+            ParamEdge edge;
+            edge.name_off = add_label(name);
+            edge.name_len = static_cast<uint32_t>(name.size());
+            edge.constraint = kv.second->constraint_.get();
+            edge.child = build_node(kv.second);
+            params.push_back(edge);
+            continue;
+        }
+
+        // the first {param} child always wins, anything after it is unreachable
+        if (param_child != k_npos)
+            continue;
+
+        if (is_wildcard_key(key))
+        {
+            Edge edge;
+            edge.label_off = add_label(key);
+            edge.label_len = static_cast<uint32_t>(key.size() - 1);
+            edge.first_len = edge.label_len;
+            edge.child = build_node(kv.second);
+            if (edge.label_len == 0)
+                star_child = edge.child;
+            wildcards.push_back(edge);
+        } else
+        {
+            StringPiece spec;
+            RouteConstraint::split_param(key, param_name, spec);
+            param_child = build_node(kv.second);
+        }
+    }
+
+    // edges are appended after the recursion so that they stay contiguous
+    Node &n = nodes_[idx];
+    n.handler = &node->verb_handler_;
+    n.has_handler = !node->verb_handler_.empty();
+    n.is_leaf = node->children_.empty();
+    n.star_child = star_child;
+    if (param_child != k_npos)
+    {
+        ParamEdge edge;
+        edge.name_off = add_label(param_name);
+        edge.name_len = static_cast<uint32_t>(param_name.size());
+        edge.constraint = nullptr;
+        edge.child = param_child;
+        params.push_back(edge);
+    }
+    n.static_begin = static_cast<uint32_t>(static_edges_.size());
+    static_edges_.insert(static_edges_.end(), statics.begin(), statics.end());
+    n.static_end = static_cast<uint32_t>(static_edges_.size());
+    n.wildcard_begin = static_cast<uint32_t>(wildcard_edges_.size());
+    wildcard_edges_.insert(wildcard_edges_.end(), wildcards.begin(), wildcards.end());
+    n.wildcard_end = static_cast<uint32_t>(wildcard_edges_.size());
+    n.param_begin = static_cast<uint32_t>(param_edges_.size());
+    param_edges_.insert(param_edges_.end(), params.begin(), params.end());
+    n.param_end = static_cast<uint32_t>(param_edges_.size());
+    return idx;
+}
+
+int32_t RouteTrie::find_static(const Node &node, const StringPiece &mid) const
+{
+    auto first = static_edges_.begin() + node.static_begin;
+    auto last = static_edges_.begin() + node.static_end;
+    auto it = std::lower_bound(first, last, mid,
+                               [this](const Edge &edge, const StringPiece &key)
+                               {
+                                   return label(edge.label_off, edge.first_len) < key;
+                               });
+    if (it == last || label(it->label_off, it->first_len) != mid)
+        return k_npos;
+    return static_cast<int32_t>(it - static_edges_.begin());
+}
+
+// Same matching order as RouteTableNode::find :
+// exact segment first, then prefix*, then {name:spec}, then {param}
+int32_t RouteTrie::match(int32_t idx, const StringPiece &route, size_t cursor,
+                         OUT RouteParams &route_params,
+                         OUT StringPiece &route_match_path) const
+{
+    const Node &node = nodes_[idx];
+    if ((cursor == route.size() && node.has_handler) || node.is_leaf)
+        return idx;
+
+    // /static/* also matches /static
+    if (cursor == route.size())
+        return node.star_child;
+
+    if (cursor == 0 && slash_node_ != k_npos && route.size() == 1 && route[0] == '/')
+        return slash_node_;
+
+    if (route[cursor] == '/')
+        cursor++;
+    size_t anchor = cursor;
+    while (cursor < route.size() && route[cursor] != '/')
+        cursor++;
+
+    StringPiece mid(route.data() + anchor, cursor - anchor);
+
+    int32_t e = find_static(node, mid);
+    if (e != k_npos)
+    {
+        const Edge &edge = static_edges_[e];
+        size_t end = anchor + edge.label_len;
+        // the rest of a merged label must match whole segments
+        if (edge.label_len == edge.first_len ||
+            (end <= route.size() &&
+             (end == route.size() || route[end] == '/') &&
+             memcmp(route.data() + anchor, labels_.data() + edge.label_off, edge.label_len) == 0))
+        {
+            size_t captured = route_params.size();
+            int32_t res = match(edge.child, route, end, route_params, route_match_path);
+            if (res != k_npos)
+                return res;
+            route_params.truncate(captured);
+        }
+    }
+
+    for (uint32_t i = node.wildcard_begin; i < node.wildcard_end; i++)
+    {
+        const Edge &edge = wildcard_edges_[i];
+        if (mid.starts_with(label(edge.label_off, edge.label_len)))
+        {
+            route_match_path.set(mid.data(), route.size() - anchor);
+            return edge.child;
+        }
+    }
+
+    for (uint32_t i = node.param_begin; i < node.param_end; i++)
+    {
+        const ParamEdge &edge = param_edges_[i];
+        if (!edge.constraint)
+        {
+            route_params.add(label(edge.name_off, edge.name_len), mid);
+            return match(edge.child, route, cursor, route_params, route_match_path);
+        }
+        if (!edge.constraint->match(mid))
+            continue;
+        size_t captured = route_params.size();
+        route_params.add(label(edge.name_off, edge.name_len), mid);
+        int32_t res = match(edge.child, route, cursor, route_params, route_match_path);
+        if (res != k_npos)
+            return res;
+        route_params.truncate(captured);
+    }
+    return k_npos;
+}
+
+const VerbHandler *RouteTrie::find(const StringPiece &route,
+                                   OUT RouteParams &route_params,
+                                   OUT StringPiece &route_match_path) const
+{
+    if (nodes_.empty())
+        return nullptr;
+
+    int32_t idx = match(0, route, 0, route_params, route_match_path);
+    if (idx == k_npos)
+        return nullptr;
+    return nodes_[idx].handler;
+}
@@ -0,0 +1,128 @@
+#ifndef WFREST_ROUTETRIE_H_
+#define WFREST_ROUTETRIE_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+
+#include "StringPiece.h"
+#include "Macro.h"
+#include "Noncopyable.h"
+#include "VerbHandler.h"
+#include "RouteParams.h"
+
+namespace wfrest
+{
+
+class RouteTableNode;
+class RouteConstraint;
+
+// Read-only radix trie compiled from the RouteTableNode tree once all the
+// routes are registered.
+//
+// Nodes, edges and labels live in contiguous arrays :
+//  - static children of a node are sorted by their first segment and
+//    searched with binary search, chains of handler-less single children
+//    are merged into one multi-segment label (/api/v1/...)
+//  - prefix* children and the {param} children have their own slots,
+//    so a miss on the static children never rescans them
+//  - {name:spec} children are only taken if their DFA accepts the segment,
+//    they are tried before the plain {param} child
+class RouteTrie : public Noncopyable
+{
+public:
+    void build(const RouteTableNode &root);
+
+    // nullptr if the route does not match any node
+    const VerbHandler *find(const StringPiece &route,
+                            OUT RouteParams &route_params,
+                            OUT StringPiece &route_match_path) const;
+
+    // Routes without {param} or prefix*, looked up by the whole path.
+    // nullptr means the trie has to be walked.
+    const VerbHandler *find_exact(const StringPiece &route) const;
+
+    size_t node_count() const
+    { return nodes_.size(); }
+
+    size_t exact_count() const
+    { return exact_count_; }
+
+private:
+    static const int32_t k_npos = -1;
+
+    struct Node
+    {
+        const VerbHandler *handler;
+        uint32_t static_begin;
+        uint32_t static_end;
+        uint32_t wildcard_begin;
+        uint32_t wildcard_end;
+        int32_t star_child;         // the "*" child, for /static == /static/*
+        uint32_t param_begin;       // constrained ones first, then the first {param}
+        uint32_t param_end;
+        bool has_handler;
+        bool is_leaf;
+    };
+
+    // static edge : label may span several segments, "api/v1"
+    // wildcard edge : label is the prefix before '*'
+    struct Edge
+    {
+        uint32_t label_off;
+        uint32_t label_len;
+        uint32_t first_len;         // length of the first segment of label
+        int32_t child;
+    };
+
+    struct ParamEdge
+    {
+        uint32_t name_off;
+        uint32_t name_len;
+        const RouteConstraint *constraint;  // owned by the RouteTableNode, nullptr for {param}
+        int32_t child;
+    };
+
+    // open addressing, linear probing
+    struct ExactSlot
+    {
+        const VerbHandler *handler;     // nullptr if the slot is empty
+        size_t hash;
+        uint32_t key_off;
+        uint32_t key_len;
+    };
+
+    int32_t build_node(const RouteTableNode *node);
+
+    void collect_exact(int32_t idx, std::string &path,
+                       OUT std::vector<std::pair<std::string, const VerbHandler *>> &routes) const;
+
+    void build_exact();
+
+    int32_t match(int32_t idx, const StringPiece &route, size_t cursor,
+                  OUT RouteParams &route_params,
+                  OUT StringPiece &route_match_path) const;
+
+    int32_t find_static(const Node &node, const StringPiece &mid) const;
+
+    uint32_t add_label(const StringPiece &label);
+
+    StringPiece label(uint32_t off, uint32_t len) const
+    { return StringPiece(labels_.data() + off, len); }
+
+private:
+    std::vector<Node> nodes_;
+    std::vector<Edge> static_edges_;
+    std::vector<Edge> wildcard_edges_;
+    std::vector<ParamEdge> param_edges_;
+    std::string labels_;            // all the labels, packed
+    std::vector<ExactSlot> exact_slots_;
+    size_t exact_mask_ = 0;
+    size_t exact_count_ = 0;
+    int32_t slash_node_ = k_npos;   // GET("/", ...)
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_ROUTETRIE_H_
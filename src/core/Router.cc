@@ -1,5 +1,10 @@
 #include "workflow/HttpUtil.h"
 
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <thread>
+
 #include "Router.h"
 #include "HttpServerTask.h"
 #include "HttpMsg.h"
@@ -7,25 +12,407 @@
 
 using namespace wfrest;
 
+namespace
+{
+
+const size_t k_match_cache_size = 256;      // power of 2
+const size_t k_match_cache_route_len = 64;  // longer routes are not cached
+const size_t k_match_cache_params = 4;      // nor routes with more params
+
+// Direct-mapped : a new match evicts whatever was in its slot.
+// Values are stored as offsets into the route, names point into the table,
+// which is why an entry is only valid for the generation it was made in.
+struct MatchCacheEntry
+{
+    uint64_t generation;        // 0 : empty
+    size_t hash;
+    const VerbHandler *vh;
+    Verb verb;
+    uint8_t route_len;
+    uint8_t param_count;
+    bool has_match_path;
+    uint8_t match_off;
+    uint8_t match_len;
+    struct
+    {
+        StringPiece name;
+        uint8_t off;
+        uint8_t len;
+    } params[k_match_cache_params];
+    char route[k_match_cache_route_len];
+};
+
+struct MatchCache
+{
+    MatchCacheEntry entries[k_match_cache_size];
+};
+
+// one per thread, so lookups and updates need no synchronization
+MatchCacheEntry &match_cache_slot(size_t hash)
+{
+    static thread_local std::unique_ptr<MatchCache> cache;
+    if (!cache)
+        cache.reset(new MatchCache());
+    return cache->entries[(hash ^ (hash >> 16)) & (k_match_cache_size - 1)];
+}
+
+size_t match_cache_hash(Verb verb, const StringPiece &route)
+{
+    return StringPieceHash()(route) * 31 + static_cast<size_t>(verb);
+}
+
+bool match_cache_get(const MatchCacheEntry &entry, uint64_t generation,
+                     size_t hash, Verb verb, const StringPiece &route,
+                     OUT RouteParams &route_params,
+                     OUT StringPiece &route_match_path)
+{
+    if (entry.generation != generation || entry.hash != hash || entry.verb != verb ||
+        entry.route_len != route.size() || memcmp(entry.route, route.data(), route.size()) != 0)
+        return false;
+
+    for (uint8_t i = 0; i < entry.param_count; i++)
+    {
+        route_params.add(entry.params[i].name,
+                         StringPiece(route.data() + entry.params[i].off, entry.params[i].len));
+    }
+    if (entry.has_match_path)
+        route_match_path.set(route.data() + entry.match_off, entry.match_len);
+    return true;
+}
+
+void match_cache_put(MatchCacheEntry &entry, uint64_t generation,
+                     size_t hash, Verb verb, const StringPiece &route, const VerbHandler *vh,
+                     const RouteParams &route_params,
+                     const StringPiece &route_match_path)
+{
+    if (route_params.size() > k_match_cache_params)
+        return;
+
+    entry.generation = generation;
+    entry.hash = hash;
+    entry.vh = vh;
+    entry.verb = verb;
+    entry.route_len = static_cast<uint8_t>(route.size());
+    memcpy(entry.route, route.data(), route.size());
+    entry.param_count = static_cast<uint8_t>(route_params.size());
+    for (size_t i = 0; i < route_params.size(); i++)
+    {
+        const RouteParam &param = route_params[i];
+        entry.params[i].name = param.name;
+        entry.params[i].off = static_cast<uint8_t>(param.value.data() - route.data());
+        entry.params[i].len = static_cast<uint8_t>(param.value.size());
+    }
+    entry.has_match_path = route_match_path.data() != nullptr;
+    if (entry.has_match_path)
+    {
+        entry.match_off = static_cast<uint8_t>(route_match_path.data() - route.data());
+        entry.match_len = static_cast<uint8_t>(route_match_path.size());
+    }
+}
+
+std::atomic<uint64_t> g_next_router_id{1};
+std::atomic<size_t> g_next_thread_index{0};
+
+// only the owning thread writes, no need for a locked add
+inline void bump(std::atomic<uint64_t> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+namespace wfrest
+{
+
+// What one thread keeps for one router, only that thread writes to it.
+// The pad keeps the slots of two threads off the same cache line.
+struct ThreadSlot
+{
+    // the snapshot it is taking a reference to, see RouterThreads::unheld()
+    std::atomic<const RouteSnapshot *> hazard{nullptr};
+    std::atomic<uint64_t> exact_hit{0};
+    std::atomic<uint64_t> exact_miss{0};
+    std::atomic<uint64_t> cache_hit{0};
+    std::atomic<uint64_t> cache_miss{0};
+    ThreadSlot *next = nullptr;     // in RouterThreads::slots_, set once
+    char pad[64];
+};
+
+// The slots of the threads that use a router, and the snapshots it retired.
+// The request path only pushes a slot, once per thread, without a lock :
+// retired snapshots are freed by publish() and ~Router().
+class RouterThreads : public Noncopyable
+{
+public:
+    RouterThreads() : id_(g_next_router_id.fetch_add(1, std::memory_order_relaxed))
+    {}
+
+    // the snapshots still held go to the orphans
+    ~RouterThreads();
+
+    // the one of the calling thread, made on its first use
+    ThreadSlot &slot();
+
+    // snapshot is no longer published, freed once nothing holds it
+    void retire(const RouteSnapshot *snapshot);
+
+    // frees the retired snapshots nothing holds, the orphans too
+    void reclaim();
+
+    void sum(RouterStats &stats) const;
+
+private:
+    bool unheld(const RouteSnapshot *snapshot) const;
+
+private:
+    const uint64_t id_;     // never reused, tells the slots of routers apart
+    std::atomic<ThreadSlot *> slots_{nullptr};      // a thread each, pushed only
+    std::mutex mutex_;      // for retired_, publish() and ~Router() only
+    std::vector<const RouteSnapshot *> retired_;
+};
+
+}  // namespace wfrest
+
+namespace
+{
+
+// Retired snapshots still held when their router went away. Nothing can
+// take a new reference to them, the publish() or ~Router() of any router
+// frees them once released. Never destroyed, a static Router may go after.
+std::mutex &orphans_mutex()
+{
+    static std::mutex *mutex = new std::mutex;
+    return *mutex;
+}
+
+std::vector<const RouteSnapshot *> &orphans()
+{
+    static auto *orphans = new std::vector<const RouteSnapshot *>;
+    return *orphans;
+}
+
+}  // namespace
+
+RouterThreads::~RouterThreads()
+{
+    if (!retired_.empty())
+    {
+        std::lock_guard<std::mutex> lock(orphans_mutex());
+        orphans().insert(orphans().end(), retired_.begin(), retired_.end());
+    }
+    ThreadSlot *slot = slots_.load();
+    while (slot)
+    {
+        ThreadSlot *next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+ThreadSlot &RouterThreads::slot()
+{
+    // the router this thread used last, nearly always the only one
+    static thread_local uint64_t last_id = 0;
+    static thread_local ThreadSlot *last = nullptr;
+    static thread_local std::vector<std::pair<uint64_t, ThreadSlot *>> owned;
+    if (last_id == id_)
+        return *last;
+
+    last_id = id_;
+    for (auto &pair : owned)
+    {
+        if (pair.first == id_)
+        {
+            last = pair.second;
+            return *last;
+        }
+    }
+    last = new ThreadSlot;
+    owned.emplace_back(id_, last);
+    ThreadSlot *head = slots_.load();
+    do
+    {
+        last->next = head;
+    } while (!slots_.compare_exchange_weak(head, last));
+    return *last;
+}
+
+void RouterThreads::retire(const RouteSnapshot *snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.push_back(snapshot);
+    }
+    this->reclaim();
+}
+
+void RouterThreads::reclaim()
+{
+    std::vector<const RouteSnapshot *> unheld;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = retired_.begin();
+        while (it != retired_.end())
+        {
+            if (this->unheld(*it))
+            {
+                unheld.push_back(*it);
+                it = retired_.erase(it);
+            } else
+            {
+                ++it;
+            }
+        }
+    }
+    {
+        // no hazard to wait for, their routers are gone
+        std::lock_guard<std::mutex> lock(orphans_mutex());
+        auto it = orphans().begin();
+        while (it != orphans().end())
+        {
+            if ((*it)->released() == (*it)->acquired())
+            {
+                unheld.push_back(*it);
+                it = orphans().erase(it);
+            } else
+            {
+                ++it;
+            }
+        }
+    }
+    for (const RouteSnapshot *snapshot : unheld)
+        delete snapshot;
+}
+
+// A thread sets its hazard before it loads snapshot_ again in acquire(),
+// and clears it once its count is in. The snapshot is no longer published :
+// once a hazard is seen cleared, that thread either counted or took the new
+// one, and no reference to this one can be taken again. Waiting one out is
+// bounded. released is summed before acquired, a reference cannot be
+// dropped before it is taken, so a held one always shows.
+bool RouterThreads::unheld(const RouteSnapshot *snapshot) const
+{
+    for (ThreadSlot *slot = slots_.load(); slot; slot = slot->next)
+    {
+        while (slot->hazard.load() == snapshot)
+            std::this_thread::yield();
+    }
+    uint64_t released = snapshot->released();
+    return snapshot->acquired() == released;
+}
+
+void RouterThreads::sum(RouterStats &stats) const
+{
+    for (ThreadSlot *slot = slots_.load(); slot; slot = slot->next)
+    {
+        stats.exact_hit += slot->exact_hit.load(std::memory_order_relaxed);
+        stats.exact_miss += slot->exact_miss.load(std::memory_order_relaxed);
+        stats.cache_hit += slot->cache_hit.load(std::memory_order_relaxed);
+        stats.cache_miss += slot->cache_miss.load(std::memory_order_relaxed);
+    }
+}
+
+RouteSnapshot::RefShard &RouteSnapshot::shard() const
+{
+    static thread_local size_t index =
+            g_next_thread_index.fetch_add(1, std::memory_order_relaxed) % k_ref_shards;
+    return shards_[index];
+}
+
+uint64_t RouteSnapshot::acquired() const
+{
+    uint64_t acquired = 0;
+    for (const RefShard &shard : shards_)
+        acquired += shard.acquired.load();
+    return acquired;
+}
+
+uint64_t RouteSnapshot::released() const
+{
+    uint64_t released = 0;
+    for (const RefShard &shard : shards_)
+        released += shard.released.load();
+    return released;
+}
+
+void RouteSnapshot::unref() const
+{
+    this->shard().released.fetch_add(1);
+}
+
+Router::Router() : threads_(new RouterThreads)
+{}
+
 // 处理请求路由
 void Router::handle(const char *route, int compute_queue_id, const WrapHandler &handler, Verb verb)
 {
     VerbHandler &vh = routes_map_.find_or_create(route);
-    if(vh.verb_handler_map.find(verb) != vh.verb_handler_map.end()) 
+    if (!vh.insert(verb, handler))
     {
         fprintf(stderr, "duplicate verb\n");
         return;
     }
-    vh.verb_handler_map.insert({verb, handler});
     vh.path = route;
     vh.compute_queue_id = compute_queue_id;
 }
 
-int Router::call(Verb verb, const std::string &route, HttpServerTask *server_task) const
+bool Router::remove(const char *route, Verb verb)
 {
-    HttpReq *req = server_task->get_req();
-    HttpResp *resp = server_task->get_resp();
+    return routes_map_.remove(route, verb);
+}
+
+void Router::publish()
+{
+    auto *snapshot = new RouteSnapshot;
+    bool intercepts_body = false;
+    unsigned verbs = 0;
+    routes_map_.for_each_verb_handler([snapshot, &intercepts_body, &verbs](const VerbHandler &verb_handler)
+                        {
+                            VerbHandler &vh = snapshot->table_.find_or_create(verb_handler.path.c_str());
+                            vh = verb_handler;
+                            if (verb_handler.options.intercepts_body())
+                                intercepts_body = true;
+                            for (const auto &pair : verb_handler.verb_handler_map())
+                                verbs |= pair.first == Verb::ANY ? ~0u : 1u << static_cast<int>(pair.first);
+                        });
+    snapshot->table_.freeze();
+    intercepts_body_.store(intercepts_body, std::memory_order_relaxed);
+    verbs_.store(verbs, std::memory_order_relaxed);
+
+    const RouteSnapshot *old = snapshot_.exchange(snapshot);
+    if (old)
+        threads_->retire(old);
+}
+
+const RouteSnapshot *Router::acquire(ThreadSlot &slot) const
+{
+    // Once the hazard is set, a snapshot still published after it cannot
+    // be freed before its reference is counted, see RouterThreads::unheld()
+    const RouteSnapshot *snapshot = snapshot_.load();
+    while (snapshot)
+    {
+        slot.hazard.store(snapshot);
+        const RouteSnapshot *published = snapshot_.load();
+        if (published == snapshot)
+            break;
+        snapshot = published;
+    }
+    if (snapshot)
+        snapshot->shard().acquired.fetch_add(1);
+    slot.hazard.store(nullptr);
+    return snapshot;
+}
+
+Router::~Router()
+{
+    // freed here if nothing holds it, else by a later reclaim()
+    const RouteSnapshot *snapshot = snapshot_.exchange(nullptr);
+    if (snapshot)
+        threads_->retire(snapshot);
+}
 
+int Router::match(Verb verb, const StringPiece &route, HttpReq *req) const
+{
     // skip the last / of the url. Except for /
     // /hello ==  /hello/
     // / not change
@@ -33,41 +420,89 @@ int Router::call(Verb verb, const std::string &route, HttpServerTask *server_tas
     if (route2.size() > 1 and route2[static_cast<int>(route2.size()) - 1] == '/')
         route2.remove_suffix(1);
 
-    std::map<std::string, std::string> route_params;
-    std::string route_match_path;
-    auto it = routes_map_.find(route2, route_params, route_match_path);
+    ThreadSlot &slot = threads_->slot();
+    const RouteSnapshot *snapshot = acquire(slot);
+    if (!snapshot)
+    {
+        req->set_route_status(StatusRouteNotFound);
+        return StatusRouteNotFound;
+    }
+    const RouteTable &routes_map = snapshot->table();
 
-    int error_code = StatusOK;
-    if (it != routes_map_.end())   // has route
+    RouteParams route_params;
+    StringPiece route_match_path;
+    const VerbHandler *vh = routes_map.find_exact(route2);
+    if (vh)
     {
-        // match verb
-        // it == <StringPiece : path, VerbHandler>
-        std::map<Verb, WrapHandler> &verb_handler_map = it->second.verb_handler_map;
-        bool has_verb = verb_handler_map.find(verb) != verb_handler_map.end() ? true : false;
-        if(verb_handler_map.find(Verb::ANY) != verb_handler_map.end() or has_verb)
+        bump(slot.exact_hit);
+    } else
+    {
+        bump(slot.exact_miss);
+        if (match_cache_.load(std::memory_order_relaxed) && route2.size() <= k_match_cache_route_len)
         {
-            req->set_full_path(it->second.path);                    // 设置路由的完整路径
-            req->set_route_params(std::move(route_params));         // 设置路由的参数
-            req->set_route_match_path(std::move(route_match_path)); // 设置路由的匹配路径
-            WFGoTask * go_task;
-            if(has_verb) 
+            uint64_t generation = routes_map.generation();
+            size_t hash = match_cache_hash(verb, route2);
+            MatchCacheEntry &entry = match_cache_slot(hash);
+            if (match_cache_get(entry, generation, hash, verb, route2,
+                                route_params, route_match_path))
             {
-                go_task = it->second.verb_handler_map[verb](req, resp, series_of(server_task)); // WrapHandler 处理函数 调用
-            } else 
+                bump(slot.cache_hit);
+                vh = entry.vh;
+            } else
             {
-                go_task = it->second.verb_handler_map[Verb::ANY](req, resp, series_of(server_task));    // WrapHandler 处理函数 调用
+                bump(slot.cache_miss);
+                vh = routes_map.find(route2, route_params, route_match_path);
+                if (vh)
+                    match_cache_put(entry, generation, hash, verb, route2, vh,
+                                    route_params, route_match_path);
             }
-            if(go_task)
-                **server_task << go_task;
         } else
         {
-            error_code = StatusRouteVerbNotImplment;
+            vh = routes_map.find(route2, route_params, route_match_path);
         }
-    } else
+    }
+
+    int status = StatusRouteNotFound;
+    if (vh)   // has route
     {
-        error_code = StatusRouteNotFound;
+        // match verb, falls back to ANY
+        if (vh->find(verb))
+        {
+            status = StatusOK;
+            req->set_route_snapshot(snapshot);              // keeps the strings below alive
+            snapshot = nullptr;
+            req->set_route_verb_handler(vh);
+            req->set_full_path(&vh->path);                  // 设置路由的完整路径
+            req->set_route_params(route_params);            // 设置路由的参数
+            req->set_route_match_path(route_match_path);    // 设置路由的匹配路径
+            req->set_route_options(&vh->options);
+        } else
+        {
+            status = StatusRouteVerbNotImplment;
+        }
     }
-    return error_code;
+    req->set_route_status(status);
+    if (snapshot)
+        snapshot->unref();
+    return status;
+}
+
+void Router::run(Verb verb, HttpServerTask *server_task)
+{
+    HttpReq *req = server_task->get_req();
+    HttpResp *resp = server_task->get_resp();
+    const WrapHandler *handler = req->route_verb_handler()->find(verb);
+    WFGoTask *go_task = (*handler)(req, resp, series_of(server_task)); // WrapHandler 处理函数 调用
+    if(go_task)
+        **server_task << go_task;
+}
+
+int Router::call(Verb verb, const StringPiece &route, HttpServerTask *server_task) const
+{
+    int status = this->match(verb, route, server_task->get_req());
+    if (status == StatusOK)
+        Router::run(verb, server_task);
+    return status;
 }
 
 // 打印路由
@@ -77,14 +512,14 @@ void Router::print_routes() const
                         {
                             if(prefix == "/")
                             {
-                                for(auto& vh : verb_handler.verb_handler_map)
+                                for(auto& vh : verb_handler.verb_handler_map())
                                 {
                                     fprintf(stderr, "[WFREST] %s\t%s\n", verb_to_str(vh.first), prefix.c_str());
                                 }
                             }
                             else 
                             {
-                                for(auto& vh : verb_handler.verb_handler_map)
+                                for(auto& vh : verb_handler.verb_handler_map())
                                 {
                                     fprintf(stderr, "[WFREST] %s\t/%s\n", verb_to_str(vh.first), prefix.c_str());
                                 }
@@ -97,10 +532,21 @@ std::vector<std::pair<std::string, std::string> > Router::all_routes() const
     std::vector<std::pair<std::string, std::string> > res;
     routes_map_.all_routes([&res](const std::string &prefix, const VerbHandler &verb_handler)
                         {
-                            for(auto& vh : verb_handler.verb_handler_map)
+                            for(auto& vh : verb_handler.verb_handler_map())
                             {
                                 res.emplace_back(verb_to_str(vh.first), prefix.c_str());
                             }
                         });
     return res;
 }
+
+RouterStats Router::stats() const
+{
+    RouterStats stats;
+    stats.exact_hit = 0;
+    stats.exact_miss = 0;
+    stats.cache_hit = 0;
+    stats.cache_miss = 0;
+    threads_->sum(stats);
+    return stats;
+}
@@ -2,29 +2,151 @@
 #define WFREST_ROUTER_H_
 
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "RouteTable.h"
 #include "Noncopyable.h"
+#include "Macro.h"
 
 namespace wfrest
 {
 
 class HttpServerTask;
 
+struct RouterStats
+{
+    uint64_t exact_hit;     // served by the parameter-free route table
+    uint64_t exact_miss;    // fell back to the trie
+    uint64_t cache_hit;     // exact misses served by the match cache
+    uint64_t cache_miss;    // exact misses that walked the trie, with the cache on
+};
+
+struct ThreadSlot;
+class RouterThreads;
+
+// A frozen copy of the routes, published by Router::publish().
+// Each request that matched against it holds a reference until it is
+// destroyed : the route params, full_path() and the handler all live here.
+// References are counted per thread, in counters that only go up, so
+// taking and dropping one writes nothing another thread writes too.
+// Once retired, it is freed by the first publish() or ~Router() to find
+// it no longer held, of any router once its own is gone.
+class RouteSnapshot : public Noncopyable
+{
+public:
+    const RouteTable &table() const
+    { return table_; }
+
+    // drops the reference Router::acquire() took, from any thread
+    void unref() const;
+
+private:
+    RouteSnapshot() = default;
+
+    static const size_t k_ref_shards = 64;
+
+    // 128 bytes : the counters of two shards never share a cache line,
+    // even in an allocation only aligned on 16
+    struct RefShard
+    {
+        std::atomic<uint64_t> acquired{0};
+        std::atomic<uint64_t> released{0};
+        char pad[112];
+    };
+
+    // the one of the calling thread, shared past k_ref_shards threads
+    RefShard &shard() const;
+
+    uint64_t acquired() const;
+
+    uint64_t released() const;
+
+private:
+    RouteTable table_;
+    mutable RefShard shards_[k_ref_shards];
+
+    friend class Router;
+    friend class RouterThreads;
+};
+
 class Router : public Noncopyable
 {
 public:
+    Router();
+
+    ~Router();
+
     // 处理路由
+    // handle() and remove() only change the draft, see publish()
     void handle(const char *route, int compute_queue_id, const WrapHandler &handler, Verb verb);
 
-    int call(Verb verb, const std::string &route, HttpServerTask *server_task) const;
+    // created if route is not registered yet, same draft rules as handle()
+    RouteOptions &route_options(const char *route)
+    { return routes_map_.find_or_create(route).options; }
+
+    // false if route has no handler for verb
+    bool remove(const char *route, Verb verb);
+
+
+    // a published route has RouteOptions::intercepts_body()
+    bool intercepts_body() const
+    { return intercepts_body_.load(std::memory_order_relaxed); }
+
+    // 1 << Verb of each verb a published route takes, a route for ANY takes all
+    unsigned verbs() const
+    { return verbs_.load(std::memory_order_relaxed); }
+
+    // Match route and keep what was found on req, with a reference to the
+    // snapshot it is in : the VerbHandler, full_path(), the params and the
+    // options, see HttpReq::route_status(). StatusOK if there is a handler.
+    // route must outlive the request, the params captured point into it.
+    // Only sees the routes of the last publish().
+    int match(Verb verb, const StringPiece &route, HttpReq *req) const;
+
+    // runs the handler match() found for the request of server_task
+    static void run(Verb verb, HttpServerTask *server_task);
+
+    // match() then run()
+    int call(Verb verb, const StringPiece &route, HttpServerTask *server_task) const;
+
+    // Compile a copy of the draft and swap it in, RCU style : match() never
+    // blocks, requests in flight keep the snapshot they matched against.
+    // Dropping a reference only counts it, the snapshots they are done
+    // with are freed here, by the next publish() or by ~Router(). Nor does
+    // publish() wait for them, it only waits out the few instructions a
+    // thread needs to take a reference to the old one.
+    // Not thread safe against handle(), remove() or another publish().
+    void publish();
+
+    // Remember the last matches of the routes the exact table misses
+    // ({param}, prefix*) in a small per-thread cache. Off by default.
+    // Safe while requests are served, they see the change soon after.
+    void set_match_cache(bool enable)
+    { match_cache_.store(enable, std::memory_order_relaxed); }
 
     // 打印路由信息，
     void print_routes() const;   // for logging
 
     std::vector<std::pair<std::string, std::string>> all_routes() const;   // for test 
 
+    // sums the counters of all the threads, each may be a little behind
+    RouterStats stats() const;
+
+private:
+    // nullptr if nothing was published yet, a reference is taken.
+    // slot is the one of the calling thread.
+    const RouteSnapshot *acquire(ThreadSlot &slot) const;
+
 private:
-    RouteTable routes_map_;     // 路由表 存储
+    RouteTable routes_map_;     // 路由表 存储, draft of the next snapshot
+
+    std::atomic<const RouteSnapshot *> snapshot_{nullptr};
+    // per-thread counters and hazards, the retired snapshots
+    std::unique_ptr<RouterThreads> threads_;
+    std::atomic<bool> match_cache_{false};
+    std::atomic<bool> intercepts_body_{false};
+    std::atomic<unsigned> verbs_{0};
 
     friend class BluePrint;
 };
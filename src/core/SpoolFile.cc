@@ -0,0 +1,170 @@
+#include "workflow/WFTaskFactory.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SpoolFile.h"
+
+using namespace wfrest;
+
+void SpoolWrites::begin()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_++;
+}
+
+void SpoolWrites::end(bool ok)
+{
+    std::function<void()> cb;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok)
+            failed_ = true;
+        if (--pending_ == 0)
+            cb = std::move(on_drained_);
+    }
+    if (cb)
+        cb();
+}
+
+void SpoolWrites::when_drained(std::function<void()> cb)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_ > 0)
+        {
+            on_drained_ = std::move(cb);
+            return;
+        }
+    }
+    cb();
+}
+
+bool SpoolWrites::failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+std::shared_ptr<SpoolFile> SpoolFile::create(const std::string &dir,
+                                             const std::shared_ptr<SpoolWrites> &writes)
+{
+    std::string path = dir + "/wfrest.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        return nullptr;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return std::shared_ptr<SpoolFile>(new SpoolFile(fd, std::move(path), writes));
+}
+
+SpoolFile::SpoolFile(int fd, std::string &&path, const std::shared_ptr<SpoolWrites> &writes)
+    : fd_(fd),
+      path_(std::move(path)),
+      dev_(0),
+      ino_(0),
+      size_(0),
+      writes_(writes),
+      written_(0),
+      failed_(false)
+{
+    struct stat st;
+    if (fstat(fd_, &st) == 0)
+    {
+        dev_ = st.st_dev;
+        ino_ = st.st_ino;
+    }
+}
+
+SpoolFile::~SpoolFile()
+{
+    close(fd_);
+    // the handler may have renamed it away, and the name been reused since
+    struct stat st;
+    if (stat(path_.c_str(), &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_)
+        unlink(path_.c_str());
+}
+
+void SpoolFile::write(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = k_write_size - buf_.size();
+        if (n > len)
+            n = len;
+        buf_.append(data, n);
+        data += n;
+        len -= n;
+        if (buf_.size() == k_write_size)
+            flush();
+    }
+}
+
+void SpoolFile::flush()
+{
+    if (buf_.empty())
+        return;
+
+    auto *data = new std::string(std::move(buf_));
+    buf_.clear();
+    off_t offset = size_;
+    size_ += data->size();
+
+    std::shared_ptr<SpoolFile> self = shared_from_this();
+    std::shared_ptr<SpoolWrites> writes = writes_;
+    writes->begin();
+    WFFileIOTask *task = WFTaskFactory::create_pwrite_task(fd_, data->data(), data->size(), offset,
+        [self, data, offset, writes](WFFileIOTask *task)
+        {
+            bool ok = task->get_state() == WFT_STATE_SUCCESS &&
+                      task->get_retval() == static_cast<long>(data->size());
+            self->mark_written(offset, data->size(), ok);
+            delete data;
+            writes->end(ok);
+        });
+    task->start();
+}
+
+size_t SpoolFile::written() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+bool SpoolFile::failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+void SpoolFile::on_written(std::function<void()> cb)
+{
+    std::lock_guard<std::mutex> lock(hook_mutex_);
+    on_written_ = std::move(cb);
+}
+
+void SpoolFile::mark_written(size_t offset, size_t len, bool ok)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok)
+            failed_ = true;
+        if (offset != written_)
+        {
+            done_[offset] = len;
+        } else
+        {
+            written_ += len;
+            auto it = done_.begin();
+            while (it != done_.end() && it->first == written_)
+            {
+                written_ += it->second;
+                it = done_.erase(it);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(hook_mutex_);
+    if (on_written_)
+        on_written_();
+}
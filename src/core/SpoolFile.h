@@ -0,0 +1,98 @@
+#ifndef WFREST_SPOOLFILE_H_
+#define WFREST_SPOOLFILE_H_
+
+#include <sys/types.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "Noncopyable.h"
+
+namespace wfrest
+{
+
+// The pwrite tasks in flight for the spool files of one request
+class SpoolWrites : public Noncopyable
+{
+public:
+    void begin();
+
+    void end(bool ok);
+
+    // cb runs once nothing is in flight, right here if that is already
+    // the case, otherwise in the file io thread of the last write
+    void when_drained(std::function<void()> cb);
+
+    bool failed() const;
+
+private:
+    mutable std::mutex mutex_;
+    int pending_ = 0;
+    bool failed_ = false;
+    std::function<void()> on_drained_;
+};
+
+// A temp file filled through async pwrite tasks, in k_write_size pieces.
+// Removed once the last reference goes, which the writes in flight hold.
+class SpoolFile : public Noncopyable, public std::enable_shared_from_this<SpoolFile>
+{
+public:
+    static const size_t k_write_size = 256 * 1024;
+
+    // nullptr if no file can be made in dir
+    static std::shared_ptr<SpoolFile> create(const std::string &dir,
+                                             const std::shared_ptr<SpoolWrites> &writes);
+
+    ~SpoolFile();
+
+    void write(const char *data, size_t len);
+
+    // start the write of what is buffered
+    void flush();
+
+    const std::string &path() const
+    { return path_; }
+
+    int fd() const
+    { return fd_; }
+
+    // written or in flight
+    size_t size() const
+    { return size_; }
+
+    // all the bytes before this are written, whatever order the writes end in
+    size_t written() const;
+
+    // a write failed, its bytes still count in written()
+    bool failed() const;
+
+    // cb runs in the file io thread once each write is in written(), nullptr
+    // to stop : does not return while cb runs
+    void on_written(std::function<void()> cb);
+
+private:
+    SpoolFile(int fd, std::string &&path, const std::shared_ptr<SpoolWrites> &writes);
+
+    void mark_written(size_t offset, size_t len, bool ok);
+
+private:
+    int fd_;
+    std::string path_;
+    dev_t dev_;
+    ino_t ino_;
+    size_t size_;
+    std::string buf_;
+    std::shared_ptr<SpoolWrites> writes_;
+
+    mutable std::mutex mutex_;          // for the three below
+    size_t written_;
+    std::map<size_t, size_t> done_;     // offset to length, written past a gap
+    bool failed_;
+    std::mutex hook_mutex_;             // held while on_written_ runs
+    std::function<void()> on_written_;
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_SPOOLFILE_H_
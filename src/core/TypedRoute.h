@@ -0,0 +1,139 @@
+#ifndef WFREST_TYPEDROUTE_H_
+#define WFREST_TYPEDROUTE_H_
+
+#include <functional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "HttpMsg.h"
+#include "ErrorCode.h"
+#include "NumUtil.h"
+
+namespace wfrest
+{
+
+// How a {param} is converted into a handler argument.
+// Specialize it to accept your own types.
+template<typename T>
+struct RouteArg
+{
+    static_assert((std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+                  std::is_floating_point<T>::value,
+                  "a typed route param is an integer, a floating point number, "
+                  "StringPiece, std::string or a type RouteArg is specialized for");
+
+    static bool parse(const StringPiece &str, OUT T &val)
+    { return NumUtil::parse(str, val); }
+};
+
+// view into the request path
+template<>
+struct RouteArg<StringPiece>
+{
+    static bool parse(const StringPiece &str, OUT StringPiece &val)
+    {
+        val = str;
+        return true;
+    }
+};
+
+template<>
+struct RouteArg<std::string>
+{
+    static bool parse(const StringPiece &str, OUT std::string &val)
+    {
+        val = str.as_string();
+        return true;
+    }
+};
+
+// number of {param} segments in a route
+inline size_t route_param_count(const char *route)
+{
+    size_t count = 0;
+    for (const char *p = route; *p; p++)
+    {
+        if (*p == '{' && (p == route || p[-1] == '/'))
+            count++;
+    }
+    return count;
+}
+
+namespace detail
+{
+
+template<size_t... I>
+struct IndexSeq {};
+
+template<size_t N, size_t... I>
+struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+
+template<size_t... I>
+struct MakeIndexSeq<0, I...>
+{
+    using type = IndexSeq<I...>;
+};
+
+// true, or the static_assert of an unsupported RouteArg<T> fails
+template<typename... T>
+struct RouteArgsSupported : std::true_type {};
+
+template<typename T, typename... Rest>
+struct RouteArgsSupported<T, Rest...>
+    : std::integral_constant<bool, sizeof(RouteArg<T>) != 0 &&
+                                   RouteArgsSupported<Rest...>::value> {};
+
+}  // namespace detail
+
+// svr.GET<int, uint64_t>("/user/{id}/post/{pid}",
+//     [](const HttpReq *req, HttpResp *resp, int id, uint64_t pid) { ... });
+//
+// The params are converted by position, in route order, before the handler
+// runs. A param that does not convert answers 400 without calling it.
+// An argument type RouteArg cannot convert does not compile, and a route
+// whose number of params is not the handler's aborts when it is added.
+template<typename... Args>
+struct TypedHandler
+{
+    using type = std::function<void(const HttpReq *, HttpResp *, Args...)>;
+
+    // same type as Handler
+    static std::function<void(const HttpReq *, HttpResp *)> wrap(const type &handler)
+    {
+        return [handler](const HttpReq *req, HttpResp *resp)
+        {
+            call(handler, req, resp, typename detail::MakeIndexSeq<sizeof...(Args)>::type());
+        };
+    }
+
+private:
+    template<size_t... I>
+    static void call(const type &handler, const HttpReq *req, HttpResp *resp,
+                     detail::IndexSeq<I...>)
+    {
+        const RouteParams &params = req->params();
+        if (params.size() != sizeof...(Args))
+        {
+            resp->Error(StatusRouteParamInvalid);
+            return;
+        }
+
+        std::tuple<typename std::decay<Args>::type...> args;
+        size_t bad = sizeof...(Args);
+        int expand[] = {0, (bad == sizeof...(Args) &&
+                            !RouteArg<typename std::decay<Args>::type>::parse(
+                                    params[I].value, std::get<I>(args)) ? (bad = I, 0) : 0)...};
+        (void)expand;
+        if (bad != sizeof...(Args))
+        {
+            resp->Error(StatusRouteParamInvalid, params[bad].name.as_string());
+            return;
+        }
+        handler(req, resp, std::get<I>(args)...);
+    }
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_TYPEDROUTE_H_
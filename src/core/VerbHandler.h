@@ -2,6 +2,7 @@
 #define WFREST_VERBHANDLER_H_
 
 #include <functional>
+#include <memory>
 #include <set>
 #include "HttpMsg.h"
 
@@ -11,27 +12,57 @@ namespace wfrest
 // 动词枚举
 enum class Verb
 {
-    ANY, GET, POST, PUT, DELETE, HEAD, PATCH,
+    ANY, GET, POST, PUT, DELETE, HEAD, PATCH, OPTIONS, CONNECT, TRACE,
 };
 
+const int k_verb_count = static_cast<int>(Verb::TRACE) + 1;
+
 // 将 动词的字符串形式 转换为 动词的形式
-inline Verb str_to_verb(const std::string &verb)
+// Single pass : dispatch on the length and the first byte, then compare once.
+// Unknown methods are routed as ANY.
+inline Verb str_to_verb(const char *verb, size_t len)
 {
-    if (strcasecmp(verb.c_str(), "GET") == 0)
-        return Verb::GET;
-    if (strcasecmp(verb.c_str(), "PUT") == 0)
-        return Verb::PUT;
-    if (strcasecmp(verb.c_str(), "POST") == 0)
-        return Verb::POST;
-    if (strcasecmp(verb.c_str(), "DELETE") == 0)
-        return Verb::DELETE;
-    if (strcasecmp(verb.c_str(), "HEAD") == 0)
-        return Verb::HEAD;
-    if (strcasecmp(verb.c_str(), "PATCH") == 0)
-        return Verb::PATCH;
+    switch (len)
+    {
+        case 3:
+            if ((verb[0] | 0x20) == 'g' && strncasecmp(verb, "GET", 3) == 0)
+                return Verb::GET;
+            if ((verb[0] | 0x20) == 'p' && strncasecmp(verb, "PUT", 3) == 0)
+                return Verb::PUT;
+            break;
+        case 4:
+            if ((verb[0] | 0x20) == 'p' && strncasecmp(verb, "POST", 4) == 0)
+                return Verb::POST;
+            if ((verb[0] | 0x20) == 'h' && strncasecmp(verb, "HEAD", 4) == 0)
+                return Verb::HEAD;
+            break;
+        case 5:
+            if ((verb[0] | 0x20) == 'p' && strncasecmp(verb, "PATCH", 5) == 0)
+                return Verb::PATCH;
+            if ((verb[0] | 0x20) == 't' && strncasecmp(verb, "TRACE", 5) == 0)
+                return Verb::TRACE;
+            break;
+        case 6:
+            if (strncasecmp(verb, "DELETE", 6) == 0)
+                return Verb::DELETE;
+            break;
+        case 7:
+            if ((verb[0] | 0x20) == 'o' && strncasecmp(verb, "OPTIONS", 7) == 0)
+                return Verb::OPTIONS;
+            if ((verb[0] | 0x20) == 'c' && strncasecmp(verb, "CONNECT", 7) == 0)
+                return Verb::CONNECT;
+            break;
+        default:
+            break;
+    }
     return Verb::ANY;
 }
 
+inline Verb str_to_verb(const std::string &verb)
+{
+    return str_to_verb(verb.c_str(), verb.size());
+}
+
 // 将 动词的形式 转换为 动词的字符串形式 
 inline const char *verb_to_str(const Verb &verb)
 {
@@ -51,6 +82,12 @@ inline const char *verb_to_str(const Verb &verb)
             return "HEAD";
         case Verb::PATCH:
             return "PATCH";
+        case Verb::OPTIONS:
+            return "OPTIONS";
+        case Verb::CONNECT:
+            return "CONNECT";
+        case Verb::TRACE:
+            return "TRACE";
         default:
             return "[UNKNOWN]";
     }
@@ -58,11 +95,135 @@ inline const char *verb_to_str(const Verb &verb)
 
 using WrapHandler = std::function<WFGoTask *(HttpReq * , HttpResp *, SeriesWork *)>;
 
+// Network thread, once the headers are in and before any of the body.
+// Anything but StatusOK and the body is read and dropped, the route's
+// handler still runs with req->body_status() the value returned.
+using StreamHeadersHandler = std::function<int(HttpReq *req)>;
+
+// The body, de-chunked, a piece at a time and in order, on the compute
+// queue of the route. Anything but StatusOK drops the rest the same way.
+using StreamChunkHandler = std::function<int(HttpReq *req, const char *data, size_t len)>;
+
+// what POST_STREAM() adds to a route
+struct StreamRoute
+{
+    Verb verb;
+    int compute_queue_id;       // -1 : a queue of its own
+    StreamHeadersHandler on_headers;
+    StreamChunkHandler on_chunk;
+};
+
+// per route settings, see HttpServer::route_options()
+struct RouteOptions
+{
+    static const size_t k_default_max_decoded_body = 64 * 1024 * 1024;
+
+    // a gzip/deflate request body may not inflate past this, 413 otherwise
+    size_t max_decoded_body = k_default_max_decoded_body;
+
+    // Request body size, in place of HttpServer::request_size_limit.
+    // A larger Content-Length gets 413 as soon as the headers are in,
+    // without 100 Continue. 0 : the server wide limit.
+    size_t max_body_size = 0;
+
+    // multipart/form-data is parsed as it comes in, see HttpReq::form_parts()
+    bool stream_multipart = false;
+    // a streamed part larger than this goes to a temp file
+    size_t multipart_memory_limit = 1024 * 1024;
+
+    // set by POST_STREAM()
+    std::shared_ptr<const StreamRoute> stream;
+    // Body bytes read but not through on_chunk yet kept in memory. Past
+    // this the rest of the body goes to a temp file in the spool dir and
+    // on_chunk reads it back, body_status() is StatusFileWriteError if that
+    // fails.
+    size_t stream_buffer_limit = 1024 * 1024;
+
+    // A body larger than this goes to a temp file instead of memory, and
+    // body_view(), form(), json()... read it through an mmap. body() does
+    // not copy it back, see HttpReq::body(). 0 : no limit.
+    size_t body_memory_limit = 0;
+
+    // HttpReq has to look at the headers before the body is read
+    bool intercepts_body() const
+    {
+        return stream_multipart || stream || body_memory_limit > 0 || max_body_size > 0;
+    }
+};
+
 struct VerbHandler
 {
-    std::map<Verb, WrapHandler> verb_handler_map;   // map 存储 动词 和 WrapHandler 处理函数
     std::string path;                               // path 存储 路由
     int compute_queue_id;                           // 存储计算队列 id 
+    RouteOptions options;
+
+    // nullptr if neither the verb nor ANY is registered
+    const WrapHandler *find(Verb verb) const
+    { return verb_table_[static_cast<int>(verb)]; }
+
+    // false if verb has a handler already
+    bool insert(Verb verb, const WrapHandler &handler)
+    {
+        if (!verb_handler_map_.emplace(verb, handler).second)
+            return false;
+        update_verb_table();
+        return true;
+    }
+
+    // false if verb has no handler
+    bool erase(Verb verb)
+    {
+        if (verb_handler_map_.erase(verb) == 0)
+            return false;
+        update_verb_table();
+        return true;
+    }
+
+    // map 存储 动词 和 WrapHandler 处理函数
+    const std::map<Verb, WrapHandler> &verb_handler_map() const
+    { return verb_handler_map_; }
+
+    bool empty() const
+    { return verb_handler_map_.empty(); }
+
+    VerbHandler() : compute_queue_id(-1)
+    { update_verb_table(); }
+
+    VerbHandler(const VerbHandler &other)
+        : path(other.path),
+          compute_queue_id(other.compute_queue_id),
+          options(other.options),
+          verb_handler_map_(other.verb_handler_map_)
+    { update_verb_table(); }
+
+    VerbHandler &operator=(const VerbHandler &other)
+    {
+        verb_handler_map_ = other.verb_handler_map_;
+        path = other.path;
+        compute_queue_id = other.compute_queue_id;
+        options = other.options;
+        update_verb_table();
+        return *this;
+    }
+
+private:
+    // Indexes the map by Verb with the ANY fallback already resolved,
+    // after every change of the map.
+    void update_verb_table()
+    {
+        auto any = verb_handler_map_.find(Verb::ANY);
+        for (int i = 0; i < k_verb_count; i++)
+        {
+            auto it = verb_handler_map_.find(static_cast<Verb>(i));
+            if (it == verb_handler_map_.end())
+                it = any;
+            verb_table_[i] = it != verb_handler_map_.end() ? &it->second : nullptr;
+        }
+    }
+
+private:
+    std::map<Verb, WrapHandler> verb_handler_map_;
+    const WrapHandler *verb_table_[k_verb_count];   // points into verb_handler_map_
 };
 
 }  // namespace wfrest
@@ -0,0 +1,142 @@
+#include "JsonUtil.h"
+#include "json.hpp"
+
+#ifdef WFREST_WITH_SIMDJSON
+#include "simdjson.h"
+#endif
+
+using namespace wfrest;
+
+namespace
+{
+
+using Json = nlohmann::json;
+
+// nlohmann's own DOM builder, keeping the error instead of throwing it
+class ErrorKeepingSax
+{
+public:
+    using number_integer_t = Json::number_integer_t;
+    using number_unsigned_t = Json::number_unsigned_t;
+    using number_float_t = Json::number_float_t;
+    using string_t = Json::string_t;
+    using binary_t = Json::binary_t;
+
+    ErrorKeepingSax(Json &json, JsonError &err) : dom_(json, false), err_(err) {}
+
+    bool null() { return dom_.null(); }
+    bool boolean(bool val) { return dom_.boolean(val); }
+    bool number_integer(number_integer_t val) { return dom_.number_integer(val); }
+    bool number_unsigned(number_unsigned_t val) { return dom_.number_unsigned(val); }
+    bool number_float(number_float_t val, const string_t &s) { return dom_.number_float(val, s); }
+    bool string(string_t &val) { return dom_.string(val); }
+    bool binary(binary_t &val) { return dom_.binary(val); }
+    bool start_object(std::size_t len) { return dom_.start_object(len); }
+    bool key(string_t &val) { return dom_.key(val); }
+    bool end_object() { return dom_.end_object(); }
+    bool start_array(std::size_t len) { return dom_.start_array(len); }
+    bool end_array() { return dom_.end_array(); }
+
+    template<class Exception>
+    bool parse_error(std::size_t position, const std::string &last_token, const Exception &ex)
+    {
+        err_.offset = position;
+        err_.msg = ex.what();
+        return dom_.parse_error(position, last_token, ex);
+    }
+
+private:
+    nlohmann::detail::json_sax_dom_parser<Json> dom_;
+    JsonError &err_;
+};
+
+#ifdef WFREST_WITH_SIMDJSON
+
+// depth is bounded by simdjson, 1024 by default
+void build_json(simdjson::dom::element elem, Json &out)
+{
+    switch (elem.type())
+    {
+        case simdjson::dom::element_type::ARRAY:
+        {
+            out = Json::array();
+            simdjson::dom::array arr;
+            if (elem.get(arr) != simdjson::SUCCESS)
+                break;
+            for (simdjson::dom::element child : arr)
+            {
+                out.push_back(nullptr);
+                build_json(child, out.back());
+            }
+            break;
+        }
+        case simdjson::dom::element_type::OBJECT:
+        {
+            out = Json::object();
+            simdjson::dom::object obj;
+            if (elem.get(obj) != simdjson::SUCCESS)
+                break;
+            for (simdjson::dom::key_value_pair field : obj)
+                build_json(field.value, out[std::string(field.key)]);
+            break;
+        }
+        case simdjson::dom::element_type::INT64:
+            out = elem.get_int64().value_unsafe();
+            break;
+        case simdjson::dom::element_type::UINT64:
+            out = elem.get_uint64().value_unsafe();
+            break;
+        case simdjson::dom::element_type::DOUBLE:
+            out = elem.get_double().value_unsafe();
+            break;
+        case simdjson::dom::element_type::STRING:
+            out = std::string(elem.get_string().value_unsafe());
+            break;
+        case simdjson::dom::element_type::BOOL:
+            out = elem.get_bool().value_unsafe();
+            break;
+        default:
+            out = nullptr;
+            break;
+    }
+}
+
+#endif // WFREST_WITH_SIMDJSON
+
+}  // namespace
+
+bool JsonUtil::parse_default(const char *data, size_t len, Json &json, JsonError &err)
+{
+    err.offset = 0;
+    err.msg.clear();
+    json = Json();
+    ErrorKeepingSax sax(json, err);
+    if (Json::sax_parse(data, data + len, &sax) && err.msg.empty())
+        return true;
+
+    json = Json(Json::value_t::discarded);
+    if (err.msg.empty())
+        err.msg = "invalid json";
+    return false;
+}
+
+bool JsonUtil::parse(const char *data, size_t len, Json &json, JsonError &err)
+{
+#ifdef WFREST_WITH_SIMDJSON
+    if (len >= k_fast_parse_min)
+    {
+        // the parser keeps its buffers, one per thread
+        static thread_local simdjson::dom::parser parser;
+        simdjson::dom::element root;
+        if (parser.parse(data, len).get(root) == simdjson::SUCCESS)
+        {
+            err.offset = 0;
+            err.msg.clear();
+            build_json(root, json);
+            return true;
+        }
+        // rare, let nlohmann say where it went wrong
+    }
+#endif
+    return parse_default(data, len, json, err);
+}
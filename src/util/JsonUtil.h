@@ -0,0 +1,36 @@
+#ifndef WFREST_JSONUTIL_H_
+#define WFREST_JSONUTIL_H_
+
+#include <string>
+#include "json_fwd.hpp"
+#include "Macro.h"
+
+namespace wfrest
+{
+
+// Error of the last JsonUtil::parse
+struct JsonError
+{
+    size_t offset = 0;      // bytes read when the parser gave up
+    std::string msg;        // empty if the document was valid
+};
+
+class JsonUtil
+{
+public:
+    // With -DWFREST_WITH_SIMDJSON documents from this size on go through
+    // simdjson, then are built into the same nlohmann::json.
+    static const size_t k_fast_parse_min = 16 * 1024;
+
+    // One pass, never throws. On false json is discarded and err says where.
+    static bool parse(const char *data, size_t len,
+                      OUT nlohmann::json &json, OUT JsonError &err);
+
+    // nlohmann only, whatever the build
+    static bool parse_default(const char *data, size_t len,
+                              OUT nlohmann::json &json, OUT JsonError &err);
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_JSONUTIL_H_
@@ -0,0 +1,245 @@
+#include "KvUtil.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace wfrest;
+
+namespace
+{
+
+inline int hex_value(unsigned char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+StringPiece decode_escapes(const char *begin, const char *end, bool plus_is_space, char *out)
+{
+    char *p = out;
+    while (begin < end)
+    {
+        unsigned char c = *begin++;
+        if (c == '+' && plus_is_space)
+        {
+            c = ' ';
+        } else if (c == '%' && end - begin >= 2)
+        {
+            int hi = hex_value(begin[0]);
+            int lo = hex_value(begin[1]);
+            if (hi >= 0 && lo >= 0)
+            {
+                c = static_cast<unsigned char>(hi << 4 | lo);
+                begin += 2;
+            }
+        }
+        *p++ = c;
+    }
+    return StringPiece(out, static_cast<size_t>(p - out));
+}
+
+// Fed every delimiter and escape of the input, in order
+class Splitter
+{
+public:
+    // the decode buffer comes from arena if there is one, otherwise into buf
+    Splitter(const StringPiece &input, KvSyntax syntax, KeyValues &pairs,
+             std::unique_ptr<char[]> *buf, Arena *arena)
+        : input_(input),
+          cookie_(syntax == KvSyntax::COOKIE),
+          pairs_(pairs),
+          buf_(buf),
+          arena_(arena),
+          out_(nullptr),
+          field_(input.data()),
+          eq_(nullptr),
+          key_esc_(false),
+          value_esc_(false)
+    {}
+
+    char separator() const
+    { return cookie_ ? ';' : '&'; }
+
+    // '%' again when '+' means nothing, so it can be looked for the same way
+    char plus() const
+    { return cookie_ ? '%' : '+'; }
+
+    void on_byte(const char *p)
+    {
+        char c = *p;
+        if (c == '=')
+        {
+            if (!eq_)
+                eq_ = p;
+        } else if (c == '%' || c == '+')
+        {
+            if (eq_)
+                value_esc_ = true;
+            else
+                key_esc_ = true;
+        } else
+        {
+            end_field(p);
+            field_ = p + 1;
+            eq_ = nullptr;
+            key_esc_ = false;
+            value_esc_ = false;
+        }
+    }
+
+    void end_field(const char *end)
+    {
+        const char *key_begin = field_;
+        const char *key_end = eq_ ? eq_ : end;
+        if (cookie_)
+            trim(key_begin, key_end);
+        if (key_begin == key_end)
+            return;
+
+        KeyValue kv;
+        kv.key = piece(key_begin, key_end, key_esc_);
+        if (eq_)
+        {
+            const char *value_begin = eq_ + 1;
+            const char *value_end = end;
+            if (cookie_)
+            {
+                trim(value_begin, value_end);
+                if (value_end - value_begin >= 2 && *value_begin == '"' && value_end[-1] == '"')
+                {
+                    value_begin++;
+                    value_end--;
+                }
+            }
+            kv.value = piece(value_begin, value_end, value_esc_);
+        }
+        pairs_.push_back(kv);
+    }
+
+private:
+    static void trim(const char *&begin, const char *&end)
+    {
+        while (begin < end && is_blank(*begin))
+            begin++;
+        while (end > begin && is_blank(end[-1]))
+            end--;
+    }
+
+    StringPiece piece(const char *begin, const char *end, bool escaped)
+    {
+        if (!escaped)
+            return StringPiece(begin, static_cast<size_t>(end - begin));
+
+        // decoding never grows, the input size is enough for all of it
+        if (!out_)
+        {
+            if (arena_)
+            {
+                out_ = static_cast<char *>(arena_->allocate(input_.size(), 1));
+            } else
+            {
+                buf_->reset(new char[input_.size()]);
+                out_ = buf_->get();
+            }
+        }
+        StringPiece res = decode_escapes(begin, end, !cookie_, out_);
+        out_ += res.size();
+        return res;
+    }
+
+private:
+    StringPiece input_;
+    bool cookie_;
+    KeyValues &pairs_;
+    std::unique_ptr<char[]> *buf_;
+    Arena *arena_;
+    char *out_;
+    const char *field_;
+    const char *eq_;
+    bool key_esc_;
+    bool value_esc_;
+};
+
+void split_into(const StringPiece &input, Splitter &splitter)
+{
+    const char sep = splitter.separator();
+    const char plus = splitter.plus();
+    const char *p = input.data();
+    const char *end = p + input.size();
+#if defined(__SSE2__)
+    const __m128i sep_v = _mm_set1_epi8(sep);
+    const __m128i eq_v = _mm_set1_epi8('=');
+    const __m128i percent_v = _mm_set1_epi8('%');
+    const __m128i plus_v = _mm_set1_epi8(plus);
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, sep_v),
+                                                 _mm_cmpeq_epi8(chunk, eq_v)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, percent_v),
+                                                 _mm_cmpeq_epi8(chunk, plus_v)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        while (mask)
+        {
+            splitter.on_byte(p + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for (; p < end; p++)
+    {
+        char c = *p;
+        if (c == sep || c == '=' || c == '%' || c == plus)
+            splitter.on_byte(p);
+    }
+    splitter.end_field(end);
+}
+
+}  // namespace
+
+void KvUtil::split(const StringPiece &input, KvSyntax syntax,
+                   OUT KeyValues &pairs,
+                   OUT std::unique_ptr<char[]> &buf)
+{
+    pairs.clear();
+    buf.reset();
+    if (input.empty())
+        return;
+
+    Splitter splitter(input, syntax, pairs, &buf, nullptr);
+    split_into(input, splitter);
+}
+
+void KvUtil::split(const StringPiece &input, KvSyntax syntax,
+                   OUT KeyValues &pairs, Arena *arena)
+{
+    pairs.clear();
+    if (input.empty())
+        return;
+
+    Splitter splitter(input, syntax, pairs, nullptr, arena);
+    split_into(input, splitter);
+}
+
+std::map<std::string, std::string> KvUtil::split_to_map(const StringPiece &input, KvSyntax syntax)
+{
+    std::map<std::string, std::string> res;
+
+    KeyValues pairs;
+    std::unique_ptr<char[]> buf;
+    split(input, syntax, pairs, buf);
+    for (const KeyValue &kv : pairs)
+        res.emplace(kv.key.as_string(), kv.value.as_string());
+
+    return res;
+}
@@ -0,0 +1,59 @@
+#ifndef WFREST_KVUTIL_H_
+#define WFREST_KVUTIL_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "StringPiece.h"
+#include "Macro.h"
+#include "Arena.h"
+
+namespace wfrest
+{
+
+// key and value point into the input, or into the decode buffer
+// when they had an escape in them
+struct KeyValue
+{
+    StringPiece key;
+    StringPiece value;
+};
+
+// in the arena of the request when it has one
+using KeyValues = ArenaVector<KeyValue>;
+
+enum class KvSyntax
+{
+    // "k=v&k2=v2", a query or an application/x-www-form-urlencoded body.
+    // "%XY" and "+" are decoded.
+    URLENCODED,
+    // "k=v; k2=v2", a Cookie header. Blanks around keys and values are
+    // trimmed, a value in double quotes loses them, "%XY" is decoded.
+    COOKIE,
+};
+
+class KvUtil
+{
+public:
+    // Split input into pairs, in order, repeated keys included, in one pass
+    // that looks at 16 bytes at a time for the delimiters and escapes.
+    // Fields without a key are skipped, a field without '=' has a null value.
+    // Decoded keys and values go to buf, allocated here, only if the input
+    // has any escape. A malformed "%XY" is kept as is.
+    static void split(const StringPiece &input, KvSyntax syntax,
+                      OUT KeyValues &pairs,
+                      OUT std::unique_ptr<char[]> &buf);
+
+    // the same with the decoded ones in arena, which must not be nullptr
+    static void split(const StringPiece &input, KvSyntax syntax,
+                      OUT KeyValues &pairs, Arena *arena);
+
+    // the same into a map, the first of a repeated key wins
+    static std::map<std::string, std::string>
+    split_to_map(const StringPiece &input, KvSyntax syntax);
+};
+
+}  // namespace wfrest
+
+#endif // WFREST_KVUTIL_H_
@@ -0,0 +1,154 @@
+#ifndef WFREST_NUMUTIL_H_
+#define WFREST_NUMUTIL_H_
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <locale.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#include "StringPiece.h"
+#include "Macro.h"
+
+namespace wfrest
+{
+
+// Number parsing for views, without exceptions and without allocation.
+// The whole string must be the number : no spaces, no trailing garbage,
+// in range of T. val is left untouched if it returns false.
+class NumUtil
+{
+public:
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value, bool>::type
+    parse(const StringPiece &str, OUT T &val);
+
+    // Locale independent. Digits, an optional fraction and exponent, at
+    // most k_max_float_len chars. Out of the range of T is false.
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+    parse(const StringPiece &str, OUT T &val);
+
+    static const size_t k_max_float_len = 127;
+
+private:
+    static locale_t c_locale()
+    {
+        static locale_t loc = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+        return loc;
+    }
+
+    // strtof_l / strtod_l / strtold_l by the type of the last argument
+    static float strto_l(const char *str, char **end, locale_t loc, float *)
+    { return strtof_l(str, end, loc); }
+
+    static double strto_l(const char *str, char **end, locale_t loc, double *)
+    { return strtod_l(str, end, loc); }
+
+    static long double strto_l(const char *str, char **end, locale_t loc, long double *)
+    { return strtold_l(str, end, loc); }
+};
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, bool>::type
+NumUtil::parse(const StringPiece &str, OUT T &val)
+{
+    using U = typename std::make_unsigned<T>::type;
+
+    size_t i = 0;
+    bool neg = false;
+    if (!str.empty() && (str[0] == '+' || (std::is_signed<T>::value && str[0] == '-')))
+    {
+        neg = str[0] == '-';
+        i++;
+    }
+    if (i == str.size())
+        return false;
+
+    // |min| is max + 1 for two's complement
+    U limit = static_cast<U>(std::numeric_limits<T>::max());
+    if (neg)
+        limit += 1;
+
+    U res = 0;
+    for (; i < str.size(); i++)
+    {
+        unsigned digit = static_cast<unsigned char>(str[i]) - '0';
+        if (digit > 9)
+            return false;
+        if (res > (limit - digit) / 10)
+            return false;
+        res = res * 10 + digit;
+    }
+
+    if (neg)
+        val = res == 0 ? 0 : -static_cast<T>(res - 1) - 1;
+    else
+        val = static_cast<T>(res);
+    return true;
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+NumUtil::parse(const StringPiece &str, OUT T &val)
+{
+    // [+-]digits[.digits][(e|E)[+-]digits], a digit on one side of the dot
+    // at least. No inf, nan, hex or spaces, which strtod would take.
+    size_t i = 0;
+    size_t n = str.size();
+    if (i < n && (str[i] == '+' || str[i] == '-'))
+        i++;
+    size_t digits = 0;
+    for (; i < n && str[i] >= '0' && str[i] <= '9'; i++)
+        digits++;
+    if (i < n && str[i] == '.')
+    {
+        for (i++; i < n && str[i] >= '0' && str[i] <= '9'; i++)
+            digits++;
+    }
+    if (digits == 0)
+        return false;
+    if (i < n && (str[i] == 'e' || str[i] == 'E'))
+    {
+        i++;
+        if (i < n && (str[i] == '+' || str[i] == '-'))
+            i++;
+        size_t exp_digits = 0;
+        for (; i < n && str[i] >= '0' && str[i] <= '9'; i++)
+            exp_digits++;
+        if (exp_digits == 0)
+            return false;
+    }
+    if (i != n)
+        return false;
+
+    // strto*_l needs a terminated string. Longer is not a number anyone
+    // writes in a url, it is refused rather than cut.
+    char buf[k_max_float_len + 1];
+    if (n > k_max_float_len)
+        return false;
+    memcpy(buf, str.data(), n);
+    buf[n] = '\0';
+
+    // the "C" locale, the decimal point is '.' whatever setlocale() says
+    locale_t loc = c_locale();
+    if (!loc)
+        return false;
+    char *end;
+    errno = 0;
+    T res = strto_l(buf, &end, loc, static_cast<T *>(nullptr));
+    // ERANGE : past the range of T, or too close to 0 for it
+    if (end != buf + n || errno == ERANGE)
+        return false;
+    val = res;
+    return true;
+}
+
+}  // namespace wfrest
+
+#endif // WFREST_NUMUTIL_H_
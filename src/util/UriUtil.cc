@@ -1,45 +1,136 @@
 #include "UriUtil.h"
-#include "StrUtil.h"
+#include <ctype.h>
 
 using namespace wfrest;
 
 std::map<std::string, std::string> UriUtil::split_query(const StringPiece &query)
 {
-    std::map<std::string, std::string> res;
+    return KvUtil::split_to_map(query, KvSyntax::URLENCODED);
+}
 
-    if (query.empty())
-        return res;
+namespace
+{
 
-    std::vector<StringPiece> arr = StrUtil::split_piece<StringPiece>(query, '&');
+inline bool is_ctl(unsigned char c)
+{
+    return c <= 0x20 || c == 0x7f;
+}
+
+}  // namespace
+
+int UriUtil::parse_target(const char *target, size_t len,
+                          OUT RequestTarget &out,
+                          OUT std::unique_ptr<char[]> &buf)
+{
+    const char *cur = target;
+    const char *end = target + len;
 
-    if (arr.empty())
-        return res;
+    if (cur == end)
+        return -1;
 
-    for (const auto &ele: arr)
+    out.query.clear();
+    if (len == 1 && *cur == '*')
     {
-        if (ele.empty())
-            continue;
+        out.path.set(cur, 1);
+        return 0;
+    }
 
-        std::vector<std::string> kv = StrUtil::split_piece<std::string>(ele, '=');
-        size_t kv_size = kv.size();
-        std::string &key = kv[0];
+    if (*cur != '/')
+    {
+        // absolute-form, skip "scheme://authority"
+        const char *p = cur;
+        while (p < end && (isalnum(static_cast<unsigned char>(*p)) ||
+                           *p == '+' || *p == '-' || *p == '.'))
+            p++;
+        if (p == cur || end - p < 3 || memcmp(p, "://", 3) != 0)
+            return -1;
+        cur = p + 3;
+        while (cur < end && *cur != '/' && *cur != '?' && *cur != '#')
+        {
+            if (is_ctl(*cur))
+                return -1;
+            cur++;
+        }
+    }
 
-        if (key.empty() || res.count(key) > 0)
-            continue;
+    const char *path_begin = cur;
+    char *out_path = nullptr;   // set once the path differs from the input
+    size_t out_len = 0;
 
-        if (kv_size == 1)
+    // cur is on the '/' before each segment
+    while (cur < end && *cur == '/')
+    {
+        const char *seg = cur + 1;
+        const char *seg_end = seg;
+        while (seg_end < end && *seg_end != '/' && *seg_end != '?' && *seg_end != '#')
         {
-            res.emplace(std::move(key), "");
-            continue;
+            if (is_ctl(*seg_end))
+                return -1;
+            seg_end++;
         }
+        size_t n = seg_end - seg;
+        bool last = seg_end == end || *seg_end != '/';
+        bool dot = n == 1 && seg[0] == '.';
+        bool dot_dot = n == 2 && seg[0] == '.' && seg[1] == '.';
 
-        std::string &val = kv[1];
+        // a trailing "/" is kept as is, everything else is copied only
+        // once the output starts to differ from the input
+        if ((n == 0 && !last) || dot || dot_dot)
+        {
+            if (!out_path)
+            {
+                buf.reset(new char[end - path_begin + 1]);
+                out_path = buf.get();
+                out_len = cur - path_begin;
+                memcpy(out_path, path_begin, out_len);
+            }
+            if (dot_dot)
+            {
+                while (out_len > 0 && out_path[out_len - 1] != '/')
+                    out_len--;
+                if (out_len > 0)
+                    out_len--;
+            }
+            if (last && n > 0)
+                out_path[out_len++] = '/';
+        } else if (out_path)
+        {
+            memcpy(out_path + out_len, cur, seg_end - cur);
+            out_len += seg_end - cur;
+        }
+        cur = seg_end;
+    }
 
-        if (val.empty())
-            res.emplace(std::move(key), "");
-        else
-            res.emplace(std::move(key), std::move(val));
+    if (out_path)
+    {
+        if (out_len == 0)
+            out_path[out_len++] = '/';
+        out.path.set(out_path, out_len);
+    } else if (cur > path_begin)
+    {
+        out.path.set(path_begin, static_cast<size_t>(cur - path_begin));
+    } else
+    {
+        out.path.set("/");
     }
 
-    return res;
+    if (cur < end && *cur == '?')
+    {
+        const char *query = ++cur;
+        while (cur < end && *cur != '#')
+        {
+            if (is_ctl(*cur))
+                return -1;
+            cur++;
+        }
+        out.query.set(query, static_cast<size_t>(cur - query));
+    }
+    return 0;
+}
+
+void UriUtil::parse_query(const StringPiece &query,
+                          OUT QueryParams &params,
+                          OUT std::unique_ptr<char[]> &buf)
+{
+    KvUtil::split(query, KvSyntax::URLENCODED, params, buf);
 }
@@ -3,17 +3,51 @@
 
 #include "workflow/URIParser.h"
 #include <unordered_map>
+#include <memory>
+#include <vector>
+#include "StringPiece.h"
+#include "Macro.h"
+#include "KvUtil.h"
 
 namespace wfrest
 {
 
-class StringPiece;
+// The request-target of a request line, see UriUtil::parse_target()
+struct RequestTarget
+{
+    StringPiece path;   // never empty, starts with '/' unless asterisk()
+    StringPiece query;  // without the '?', empty if there is none
+
+    // "*", the server as a whole, only meant for OPTIONS
+    bool asterisk() const
+    { return path.size() == 1 && path.data()[0] == '*'; }
+};
+
+using QueryParam = KeyValue;
+using QueryParams = KeyValues;
 
 class UriUtil : public URIParser
 {
 public:
     static std::map<std::string, std::string>
     split_query(const StringPiece &query);
+
+    // Split an origin-form ("/path?query") or absolute-form
+    // ("http://host/path?query") request target in one pass. The
+    // asterisk-form ("*") is taken too, whatever the method, see
+    // RequestTarget::asterisk().
+    // path and query are views into target, except when the path has
+    // "//", "." or ".." segments : the normalised path is then written to
+    // buf, allocated here. ".." never climbs above "/".
+    // -1 if target is neither form or has a control character in it.
+    static int parse_target(const char *target, size_t len,
+                            OUT RequestTarget &out,
+                            OUT std::unique_ptr<char[]> &buf);
+
+    // KvUtil::split() of "k=v&k2=v2"
+    static void parse_query(const StringPiece &query,
+                            OUT QueryParams &params,
+                            OUT std::unique_ptr<char[]> &buf);
 };
 
 }  // wfrest